@@ -0,0 +1,476 @@
+/**************************************************************************
+                    offline residence time distributions
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Standalone Linux tool (no Fluent needed) that gives the full residence
+time and age distributions of a target volume (DOI) from one exported
+steady snapshot (umc_snapshot.h), where udf_of_urban_ventilation_indices.c
+only gives the bulk averages (PFR, LMAA, Tau_R, VF, TP).
+Particles are released volume-weighted at the cell centroids inside the DOI
+and moved by the random-walk model
+    dx=(u+grad(Dt))dt+sqrt(2*Dt*dt)*xi,   Dt=mut/(rho*Sct)
+with cell values of u and Dt, a Green-Gauss gradient of Dt (well-mixed
+condition) and a step limited to half a cell. After every step the particle
+is located by walking from its last cell through the faces it lies outside
+of; boundary faces with outflow absorb it, the others reflect it.
+1  forward tracking: time until the particle first leaves the DOI, i.e. the
+   residual life time, whose mean is Tau_R/2 for a uniform release;
+2  backward tracking (u reversed): time since the air entered the DOI, i.e.
+   the age of air, whose mean is LMAA.
+Particles are processed in chunks taken by the worker threads from an
+atomic counter; each chunk has its own RNG stream (xoshiro256**) and its
+own slot for the sum of the times, added up in chunk order at the end, so
+the output does not depend on the number or timing of the threads; the
+integer per-thread histograms are merged with atomic adds.
+Build: gcc -O2 -pthread -o offline_residence_time offline_residence_time.c -lm
+Usage: offline_residence_time [-j threads] [-n particles] [-dt dt] [-t tmax]
+           [-nb bins] [-seed s] [-b XA XB YA YB ZA ZB] snapshot.umc > rtd.csv
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#define UMC_SNAPSHOT_READER
+#include "umc_snapshot.h"
+
+#define Sct 0.7
+#define CHUNK 4096          //particles per work item and RNG stream
+#define WALK_MAX 64         //maximum cell-walk steps per time step
+
+typedef struct
+{
+	double xa,xb,ya,yb,za,zb;  //target volume (DOI)
+	long n;                    //particles per direction
+	double dt;                 //largest time step (s)
+	double tmax;               //histogram range (s); particles still inside are counted as overflow
+	int nb;                    //histogram bins
+	uint64_t seed;
+} config;
+
+typedef umc_snapshot snapshot;
+
+typedef struct
+{
+	int64_t *start;            //cell -> faces, CSR
+	int64_t *face;
+	double *dt;                //CFL-limited time step per cell
+	double *d;                 //eddy diffusivity Dt
+	double *gd;                //3 per cell: grad(Dt)
+	int64_t *rel;              //DOI cells of the release
+	double *rel_cdf;           //volume-weighted CDF over rel
+	int64_t n_rel;
+} mesh;
+
+typedef struct
+{
+	_Atomic uint64_t *hist;    //nb+1 bins, the last one counts t>=tmax
+	_Atomic uint64_t lost;     //particles the locator lost
+	_Atomic uint64_t done;
+	double *chunk_t;           //per chunk: sum of the times below tmax, added up in chunk order
+	double sum_t;
+} result;
+
+static config cfg={0.0,4.0,0.0,5.0,0.0,3.0,1000000,0.1,600.,120,12345};
+static snapshot snap;
+static mesh msh;
+static result res[2];          //0 forward, 1 backward
+static atomic_long next_chunk;
+
+/*******************************DOI & mesh*********************************/
+
+static int in_doi(const double p[3])
+{
+	return p[0]>=cfg.xa && p[0]<=cfg.xb && p[1]>=cfg.ya && p[1]<=cfg.yb && p[2]>=cfg.za && p[2]<=cfg.zb;
+}
+
+static void mesh_build(const snapshot *s,mesh *m)
+{
+	uint64_t nc=s->h->n_cells,nf=s->h->n_faces,c,f;
+	int64_t *fill;
+	double sum=0;
+
+	//cell->face connectivity
+	m->start=(int64_t *)calloc(nc+1,sizeof(int64_t));
+	m->face=(int64_t *)malloc((2*nf+1)*sizeof(int64_t));
+	for(f=0;f<nf;f++)
+	{
+		m->start[s->fc0[f]+1]++;
+		if(s->fc1[f]>=0) m->start[s->fc1[f]+1]++;
+	}
+	for(c=0;c<nc;c++)
+	{
+		m->start[c+1]+=m->start[c];
+	}
+	fill=(int64_t *)malloc(nc*sizeof(int64_t));
+	memcpy(fill,m->start,nc*sizeof(int64_t));
+	for(f=0;f<nf;f++)
+	{
+		m->face[fill[s->fc0[f]]++]=f;
+		if(s->fc1[f]>=0) m->face[fill[s->fc1[f]]++]=f;
+	}
+	free(fill);
+
+	//eddy diffusivity, its Green-Gauss gradient and the time step
+	m->d=(double *)malloc(nc*sizeof(double));
+	m->gd=(double *)calloc(3*nc,sizeof(double));
+	m->dt=(double *)malloc(nc*sizeof(double));
+	for(c=0;c<nc;c++)
+	{
+		m->d[c]=(s->rho[c]>0)?s->mut[c]/(s->rho[c]*Sct):0;
+	}
+	for(f=0;f<nf;f++)
+	{
+		int64_t c0=s->fc0[f],c1=s->fc1[f];
+		double df=(c1>=0)?0.5*(m->d[c0]+m->d[c1]):m->d[c0];
+		m->gd[3*c0]+=df*s->fax[f];
+		m->gd[3*c0+1]+=df*s->fay[f];
+		m->gd[3*c0+2]+=df*s->faz[f];
+		if(c1>=0)
+		{
+			m->gd[3*c1]-=df*s->fax[f];
+			m->gd[3*c1+1]-=df*s->fay[f];
+			m->gd[3*c1+2]-=df*s->faz[f];
+		}
+	}
+	for(c=0;c<nc;c++)
+	{
+		double hc=cbrt(s->vol[c]);
+		double sp=sqrt(s->u[c]*s->u[c]+s->v[c]*s->v[c]+s->w[c]*s->w[c]);
+		double t=cfg.dt;
+
+		m->gd[3*c]/=s->vol[c];
+		m->gd[3*c+1]/=s->vol[c];
+		m->gd[3*c+2]/=s->vol[c];
+		if(sp*t>0.5*hc) t=0.5*hc/sp;                      //advection
+		if(m->d[c]>0 && 2*m->d[c]*t>0.25*hc*hc) t=0.125*hc*hc/m->d[c];	//diffusion
+		m->dt[c]=t;
+	}
+
+	//volume-weighted release over the DOI cells
+	m->rel=(int64_t *)malloc((nc>0?nc:1)*sizeof(int64_t));
+	m->rel_cdf=(double *)malloc((nc>0?nc:1)*sizeof(double));
+	m->n_rel=0;
+	for(c=0;c<nc;c++)
+	{
+		double p[3]={s->cx[c],s->cy[c],s->cz[c]};
+		if(in_doi(p))
+		{
+			sum+=s->vol[c];
+			m->rel[m->n_rel]=c;
+			m->rel_cdf[m->n_rel++]=sum;
+		}
+	}
+}
+
+/*********************************RNG**************************************/
+
+typedef struct
+{
+	uint64_t s[4];
+	double spare;
+	int has_spare;
+} rng;
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z=(*x+=0x9E3779B97F4A7C15ULL);
+	z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+	z=(z^(z>>27))*0x94D049BB133111EBULL;
+	return z^(z>>31);
+}
+
+static void rng_seed(rng *r,uint64_t seed)
+{
+	int i;
+	for(i=0;i<4;i++)
+	{
+		r->s[i]=splitmix64(&seed);
+	}
+	r->has_spare=0;
+}
+
+static double rng_uniform(rng *r)
+{
+	//xoshiro256**, 53-bit uniform in [0,1)
+	uint64_t *s=r->s;
+	uint64_t x=s[1]*5,res=((x<<7)|(x>>57))*9,t=s[1]<<17;
+	s[2]^=s[0]; s[3]^=s[1]; s[1]^=s[2]; s[0]^=s[3];
+	s[2]^=t;
+	s[3]=(s[3]<<45)|(s[3]>>19);
+	return (res>>11)*(1./9007199254740992.);
+}
+
+static double rng_normal(rng *r)
+{
+	double u1,u2,rr;
+
+	if(r->has_spare)
+	{
+		r->has_spare=0;
+		return r->spare;
+	}
+	do
+	{
+		u1=2*rng_uniform(r)-1;
+		u2=2*rng_uniform(r)-1;
+		rr=u1*u1+u2*u2;
+	} while(rr>=1 || rr==0);
+	rr=sqrt(-2*log(rr)/rr);
+	r->spare=u2*rr;
+	r->has_spare=1;
+	return u1*rr;
+}
+
+/*****************************particle tracking****************************/
+
+static int locate(const snapshot *s,const mesh *m,double p[3],int64_t *cell,double dir)
+{
+	//walk from *cell towards p; returns 1 inside, 0 absorbed by an outflow, -1 lost
+	int64_t c=*cell;
+	int step;
+
+	for(step=0;step<WALK_MAX;step++)
+	{
+		double worst=0;
+		int64_t best=-1,k;
+
+		for(k=m->start[c];k<m->start[c+1];k++)
+		{
+			int64_t f=m->face[k];
+			double A[3]={s->fax[f],s->fay[f],s->faz[f]};
+			double d=((p[0]-s->fx[f])*A[0]+(p[1]-s->fy[f])*A[1]+(p[2]-s->fz[f])*A[2])/sqrt(A[0]*A[0]+A[1]*A[1]+A[2]*A[2]);
+			if(s->fc0[f]!=c) d=-d;	//make A point out of c
+			if(d>worst)
+			{
+				worst=d;
+				best=f;
+			}
+		}
+		if(best<0)
+		{
+			*cell=c;
+			return 1;
+		}
+		if(s->fc1[best]>=0)
+		{
+			c=(s->fc0[best]==c)?s->fc1[best]:s->fc0[best];
+		}
+		else
+		{
+			double A[3]={s->fax[best],s->fay[best],s->faz[best]};
+			double a=sqrt(A[0]*A[0]+A[1]*A[1]+A[2]*A[2]);
+			double un=dir*(s->u[c]*A[0]+s->v[c]*A[1]+s->w[c]*A[2]);
+			if(un>0)
+			{
+				return 0;	//left the domain through an outflow boundary
+			}
+			p[0]-=2*worst*A[0]/a;	//reflect on the wall
+			p[1]-=2*worst*A[1]/a;
+			p[2]-=2*worst*A[2]/a;
+		}
+	}
+	return -1;
+}
+
+static void track_chunk(long chunk,int back,uint64_t *hist,double *sum_t,uint64_t *lost)
+{
+	const snapshot *s=&snap;
+	const mesh *m=&msh;
+	double dir=back?-1.:1.;
+	rng r;
+	long i,i0=chunk*CHUNK,i1=i0+CHUNK;
+
+	if(i1>cfg.n) i1=cfg.n;
+	rng_seed(&r,cfg.seed^(0xD1B54A32D192ED03ULL*(uint64_t)(2*chunk+back+1)));
+	for(i=i0;i<i1;i++)
+	{
+		double p[3],t=0,x=rng_uniform(&r)*m->rel_cdf[m->n_rel-1];
+		int64_t lo=0,hi=m->n_rel-1,c;
+		int st=1;
+
+		while(lo<hi)	//release cell by bisection of the volume CDF
+		{
+			int64_t mid=(lo+hi)/2;
+			if(m->rel_cdf[mid]<x) lo=mid+1;
+			else hi=mid;
+		}
+		c=m->rel[lo];
+		p[0]=s->cx[c];
+		p[1]=s->cy[c];
+		p[2]=s->cz[c];
+
+		while(t<cfg.tmax)
+		{
+			double dt=m->dt[c],sd=sqrt(2*m->d[c]*dt);
+			p[0]+=(dir*s->u[c]+m->gd[3*c])*dt+sd*rng_normal(&r);
+			p[1]+=(dir*s->v[c]+m->gd[3*c+1])*dt+sd*rng_normal(&r);
+			p[2]+=(dir*s->w[c]+m->gd[3*c+2])*dt+sd*rng_normal(&r);
+			t+=dt;
+			st=locate(s,m,p,&c,dir);
+			if(st<=0 || !in_doi(p)) break;
+		}
+		if(st<0)
+		{
+			(*lost)++;
+		}
+		else if(t>=cfg.tmax)
+		{
+			hist[cfg.nb]++;
+		}
+		else
+		{
+			int k=(int)(t/cfg.tmax*cfg.nb);
+			hist[k<cfg.nb?k:cfg.nb-1]++;
+			*sum_t+=t;
+		}
+	}
+}
+
+static void *worker(void *arg)
+{
+	uint64_t *hist[2];
+	uint64_t lost[2]={0,0},done[2]={0,0};
+	long n_chunk=(cfg.n+CHUNK-1)/CHUNK,k;
+	int b,i;
+	(void)arg;
+
+	hist[0]=(uint64_t *)calloc(cfg.nb+1,sizeof(uint64_t));
+	hist[1]=(uint64_t *)calloc(cfg.nb+1,sizeof(uint64_t));
+	while((k=atomic_fetch_add(&next_chunk,1))<2*n_chunk)
+	{
+		b=(int)(k%2);	//forward and backward chunks interleaved
+		track_chunk(k/2,b,hist[b],&res[b].chunk_t[k/2],&lost[b]);
+		done[b]+=((k/2+1)*CHUNK<=cfg.n)?CHUNK:cfg.n-(k/2)*CHUNK;
+	}
+	for(b=0;b<2;b++)
+	{
+		for(i=0;i<=cfg.nb;i++)
+		{
+			if(hist[b][i]) atomic_fetch_add(&res[b].hist[i],hist[b][i]);
+		}
+		atomic_fetch_add(&res[b].lost,lost[b]);
+		atomic_fetch_add(&res[b].done,done[b]);
+		free(hist[b]);
+	}
+	return NULL;
+}
+
+/*********************************output***********************************/
+
+static void print_results(const char *file)
+{
+	double w=cfg.tmax/cfg.nb;
+	uint64_t n[2];
+	int b,i;
+
+	for(b=0;b<2;b++)
+	{
+		uint64_t in=0;
+		for(i=0;i<cfg.nb;i++) in+=res[b].hist[i];
+		n[b]=res[b].done-res[b].lost;
+		printf("# %s %s: %llu particles, %llu lost, %llu beyond tmax, mean %g s (over particles below tmax)\n",file,b?"age":"residual_life",
+			(unsigned long long)res[b].done,(unsigned long long)res[b].lost,(unsigned long long)res[b].hist[cfg.nb],in?res[b].sum_t/in:0.);
+	}
+	printf("t_lo,t_hi,residual_life_pdf,age_pdf\n");
+	for(i=0;i<cfg.nb;i++)
+	{
+		printf("%g,%g,%g,%g\n",i*w,(i+1)*w,n[0]?res[0].hist[i]/(n[0]*w):0.,n[1]?res[1].hist[i]/(n[1]*w):0.);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,"usage: %s [-j threads] [-n particles] [-dt dt] [-t tmax] [-nb bins] [-seed s] [-b XA XB YA YB ZA ZB] snapshot.umc\n",prog);
+	exit(2);
+}
+
+int main(int argc,char **argv)
+{
+	int n_threads=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t *tid;
+	char err[128];
+	long n_chunk,k;
+	int i,b;
+
+	for(i=1;i<argc && argv[i][0]=='-';i++)
+	{
+		if(strcmp(argv[i],"-j")==0 && i+1<argc) n_threads=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-n")==0 && i+1<argc) cfg.n=atol(argv[++i]);
+		else if(strcmp(argv[i],"-dt")==0 && i+1<argc) cfg.dt=atof(argv[++i]);
+		else if(strcmp(argv[i],"-t")==0 && i+1<argc) cfg.tmax=atof(argv[++i]);
+		else if(strcmp(argv[i],"-nb")==0 && i+1<argc) cfg.nb=atoi(argv[++i]);
+		else if(strcmp(argv[i],"-seed")==0 && i+1<argc) cfg.seed=strtoull(argv[++i],NULL,10);
+		else if(strcmp(argv[i],"-b")==0 && i+6<argc)
+		{
+			cfg.xa=atof(argv[++i]);
+			cfg.xb=atof(argv[++i]);
+			cfg.ya=atof(argv[++i]);
+			cfg.yb=atof(argv[++i]);
+			cfg.za=atof(argv[++i]);
+			cfg.zb=atof(argv[++i]);
+		}
+		else usage(argv[0]);
+	}
+	if(argc-i!=1 || cfg.n<=0 || cfg.nb<=0 || cfg.dt<=0 || cfg.tmax<=0)
+	{
+		usage(argv[0]);
+	}
+	if(umc_snap_open(argv[i],&snap,err,sizeof(err))!=0)
+	{
+		fprintf(stderr,"%s: %s\n",argv[i],err);
+		return 1;
+	}
+	mesh_build(&snap,&msh);
+	if(msh.n_rel==0)
+	{
+		fprintf(stderr,"%s: no cell inside the DOI\n",argv[i]);
+		return 1;
+	}
+	if(n_threads<1)
+	{
+		n_threads=1;
+	}
+
+	n_chunk=(cfg.n+CHUNK-1)/CHUNK;
+	for(b=0;b<2;b++)
+	{
+		res[b].hist=(_Atomic uint64_t *)calloc(cfg.nb+1,sizeof(_Atomic uint64_t));
+		atomic_init(&res[b].lost,0);
+		atomic_init(&res[b].done,0);
+		res[b].chunk_t=(double *)calloc(n_chunk,sizeof(double));
+	}
+	atomic_init(&next_chunk,0);
+	tid=(pthread_t *)malloc(n_threads*sizeof(pthread_t));
+	for(b=0;b<n_threads;b++)
+	{
+		pthread_create(&tid[b],NULL,worker,NULL);
+	}
+	for(b=0;b<n_threads;b++)
+	{
+		pthread_join(tid[b],NULL);
+	}
+
+	for(b=0;b<2;b++)
+	{
+		res[b].sum_t=0;
+		for(k=0;k<n_chunk;k++)
+		{
+			res[b].sum_t+=res[b].chunk_t[k];	//fixed order: the same sum for any thread count
+		}
+	}
+
+	print_results(argv[i]);
+	for(b=0;b<2;b++)
+	{
+		free(res[b].chunk_t);
+		free((void *)res[b].hist);
+	}
+	free(tid);
+	umc_snap_close(&snap);
+	return 0;
+}
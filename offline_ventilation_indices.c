@@ -0,0 +1,480 @@
+/**************************************************************************
+                    offline ventilation indices
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Standalone Linux tool (no Fluent needed) that recomputes the indices of
+udf_of_urban_ventilation_indices.c from exported snapshots (umc_snapshot.h).
+Snapshots are mmap-ed and processed in parallel, one per worker thread;
+each is checked completely by umc_snap_open first, and every snapshot that
+gives no row (unreadable, or no tracer in the DOI) is reported on stderr.
+Build: gcc -O2 -pthread -o offline_ventilation_indices offline_ventilation_indices.c -lm
+Usage: offline_ventilation_indices [-j threads] [-m M] [-s species]
+           [-b XA XB YA YB ZA ZB] snapshot.umc ... > indices.csv
+       offline_ventilation_indices --bench [max_cells] > bench.json
+       offline_ventilation_indices --merge snapshot.umc snapshot.umc.p*
+One CSV row per snapshot, in the order given on the command line:
+1  Volume of target volume (vol);
+2  PFR, LMAA, Tau_R, VF, TP, Q, Tau_N, ACH, Ea, NEV;
+3  FAm_in, FAm_out & FAt across the roof and the four lateral openings;
+4  C_canopy and U_E.
+--merge joins the per-node files of a parallel export into one snapshot
+(umc_snap_merge); partition files are refused by the index computation.
+--bench times the index kernels on synthetic structured meshes of 10^4 cells
+up to max_cells (default 10^7, about 2.7 GB) and prints cells/s and faces/s
+as JSON; the meshes and fields are deterministic so runs are comparable.
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#define UMC_SNAPSHOT_READER
+#include "umc_snapshot.h"
+
+#define M 0.00001          //pollutant emmision rate (kg/m3*s)
+#define RHO 1.29           //density of air (kg/m3)
+#define Sct 0.7
+
+typedef struct
+{
+	double xa,xb,ya,yb,za,zb;  //target volume (DOI)
+	double m;                  //emission rate inside the DOI
+	int species;               //tracer species index
+} config;
+
+typedef struct
+{
+	double time;
+	double vol,PFR,LMAA,Tau_R,VF,TP,Q,Tau_N,ACH,Ea,NEV;
+	double FA_in[5],FA_out[5],FA_tur[5],a_side[5];
+	double C_canopy,U_E;
+	int ok;
+} indices;
+
+typedef umc_snapshot snapshot;	//yi is moved to the tracer species after opening
+
+static config cfg={0.0,4.0,0.0,5.0,0.0,3.0,M,0};
+static char **files;
+static int n_files;
+static indices *results;
+static atomic_int next_file;
+
+/******************************index kernels*******************************/
+
+static int doi_side(double x,double y,double z)
+{
+	//same rounding as DOI_side() in udf_of_urban_ventilation_indices.c
+	double xx=floor(x*100.0+0.5)/100.0;
+	double yy=floor(y*100.0+0.5)/100.0;
+	double zz=floor(z*100.0+0.5)/100.0;
+
+	if(xx==cfg.xa && yy>=cfg.ya && yy<=cfg.yb && zz>=cfg.za && zz<=cfg.zb) return 0;
+	if(xx==cfg.xb && yy>=cfg.ya && yy<=cfg.yb && zz>=cfg.za && zz<=cfg.zb) return 1;
+	if(xx>=cfg.xa && xx<=cfg.xb && yy==cfg.ya && zz>=cfg.za && zz<=cfg.zb) return 2;
+	if(xx>=cfg.xa && xx<=cfg.xb && yy==cfg.yb && zz>=cfg.za && zz<=cfg.zb) return 3;
+	if(xx>=cfg.xa && xx<=cfg.xb && yy>=cfg.ya && yy<=cfg.yb && zz==cfg.zb) return 4;
+	return -1;
+}
+
+static void compute_indices(const snapshot *s,indices *r)
+{
+	static const double outward[5][3]={{-1,0,0},{1,0,0},{0,-1,0},{0,1,0},{0,0,1}};
+	uint64_t nc=s->h->n_cells,nf=s->h->n_faces,c,f;
+	double vol=0,cpt=0,cpa,delta_qp=0,q=0,ap=0;
+	double in[5]={0},out[5]={0},tur[5]={0};
+	int k;
+
+	memset(r,0,sizeof(*r));
+	r->time=s->h->time;
+
+	for(c=0;c<nc;c++)
+	{
+		if(s->cx[c]>=cfg.xa && s->cx[c]<=cfg.xb && s->cy[c]>=cfg.ya && s->cy[c]<=cfg.yb && s->cz[c]>=cfg.za && s->cz[c]<=cfg.zb)
+		{
+			vol+=s->vol[c];
+			cpt+=s->yi[c]*s->vol[c];
+		}
+	}
+
+	for(f=0;f<nf;f++)
+	{
+		int64_t c0=s->fc0[f],c1=s->fc1[f];
+		double A[3],a,sgn,un,inflow,y,rho;
+		int side=doi_side(s->fx[f],s->fy[f],s->fz[f]);
+
+		if(side<0)
+		{
+			continue;
+		}
+		A[0]=s->fax[f];
+		A[1]=s->fay[f];
+		A[2]=s->faz[f];
+		a=sqrt(A[0]*A[0]+A[1]*A[1]+A[2]*A[2]);
+		sgn=(A[0]*outward[side][0]+A[1]*outward[side][1]+A[2]*outward[side][2]>=0)?1.:-1.;
+
+		if(c1<0)
+		{
+			un=sgn*(s->u[c0]*A[0]+s->v[c0]*A[1]+s->w[c0]*A[2]);
+			y=s->yi[c0];
+			rho=s->rho[c0];
+		}
+		else
+		{
+			double d[3],dd,l0,l1,w0,w1,y0=s->yi[c0],y1=s->yi[c1];
+
+			d[0]=s->cx[c1]-s->cx[c0];
+			d[1]=s->cy[c1]-s->cy[c0];
+			d[2]=s->cz[c1]-s->cz[c0];
+			dd=d[0]*d[0]+d[1]*d[1]+d[2]*d[2];
+			l0=sqrt(pow(s->fx[f]-s->cx[c0],2)+pow(s->fy[f]-s->cy[c0],2)+pow(s->fz[f]-s->cz[c0],2));
+			l1=sqrt(pow(s->fx[f]-s->cx[c1],2)+pow(s->fy[f]-s->cy[c1],2)+pow(s->fz[f]-s->cz[c1],2));
+			w0=(l0+l1>0)?l1/(l0+l1):0.5;
+			w1=1-w0;
+
+			un=sgn*((w0*s->u[c0]+w1*s->u[c1])*A[0]+(w0*s->v[c0]+w1*s->v[c1])*A[1]+(w0*s->w[c0]+w1*s->w[c1])*A[2]);
+			y=w0*y0+w1*y1;
+			rho=w0*s->rho[c0]+w1*s->rho[c1];
+			ap+=a;
+			r->a_side[side]+=a;
+			in[side]+=((fabs(un)-un)/2)*y;
+			out[side]+=((fabs(un)+un)/2)*y;
+			if(dd>0)
+			{
+				tur[side]-=((w0*s->mut[c0]+w1*s->mut[c1])/Sct)*(y1-y0)*sgn*(A[0]*d[0]+A[1]*d[1]+A[2]*d[2])/dd;
+			}
+		}
+		inflow=(fabs(un)-un)/2;
+		q+=inflow;
+		delta_qp+=rho*inflow*y;
+	}
+
+	r->vol=vol;
+	if(vol<=0 || cpt<=0)
+	{
+		return;	//reported by the caller from r->vol
+	}
+	cpa=cpt/vol;
+	r->PFR=(cfg.m*vol)/(cpa*RHO);
+	r->LMAA=cpa/cfg.m;
+	r->Tau_R=2*r->LMAA;
+	r->VF=1+delta_qp/(vol*cfg.m);
+	r->TP=vol/(r->PFR*r->VF);
+	r->Q=q;
+	r->Tau_N=vol/q;
+	r->ACH=3600/r->Tau_N;
+	r->Ea=r->Tau_N/r->Tau_R;
+	r->NEV=(ap>0)?r->PFR/ap:0;
+	for(k=0;k<5;k++)
+	{
+		r->FA_in[k]=in[k]*RHO/cfg.m;
+		r->FA_out[k]=-1*out[k]*RHO/cfg.m;
+		r->FA_tur[k]=tur[k]*RHO/cfg.m;
+	}
+	r->C_canopy=cpa;
+	if(r->a_side[4]>0)
+	{
+		r->U_E=((r->FA_in[4]+(-1*r->FA_out[4])+r->FA_tur[4])*cfg.m)/(r->a_side[4]*r->C_canopy);
+	}
+	r->ok=1;
+}
+
+/*******************************worker pool********************************/
+
+static void *worker(void *arg)
+{
+	int i;
+	(void)arg;
+
+	while((i=atomic_fetch_add(&next_file,1))<n_files)
+	{
+		snapshot s;
+		char err[128];
+
+		if(umc_snap_open(files[i],&s,err,sizeof(err))!=0)
+		{
+			fprintf(stderr,"%s: %s, row skipped\n",files[i],err);
+			continue;
+		}
+		if(s.h->n_species==0)
+		{
+			fprintf(stderr,"%s: no species in the snapshot (exported without a species model), row skipped\n",files[i]);
+			umc_snap_close(&s);
+			continue;
+		}
+		if((uint64_t)cfg.species>=s.h->n_species)
+		{
+			fprintf(stderr,"%s: species %d not in the snapshot (%u species), row skipped\n",files[i],cfg.species,s.h->n_species);
+			umc_snap_close(&s);
+			continue;
+		}
+		s.yi=s.yi+(size_t)cfg.species*s.h->n_cells;
+		compute_indices(&s,&results[i]);
+		if(!results[i].ok)
+		{
+			fprintf(stderr,"%s: %s, row skipped\n",files[i],(results[i].vol<=0)?"no cell inside the DOI":"no tracer inside the DOI");
+		}
+		umc_snap_close(&s);
+	}
+	return NULL;
+}
+
+static void print_results(void)
+{
+	static const char *side[5]={"XA","XB","YA","YB","ZB"};
+	int i,k;
+
+	printf("file,time,vol,PFR,LMAA,Tau_R,VF,TP,Q,Tau_N,ACH,Ea,NEV");
+	for(k=0;k<5;k++)
+	{
+		printf(",FAm_in_%s,FAm_out_%s,FAt_%s",side[k],side[k],side[k]);
+	}
+	printf(",C_canopy,U_E\n");
+
+	for(i=0;i<n_files;i++)
+	{
+		const indices *r=&results[i];
+
+		if(!r->ok)
+		{
+			continue;
+		}
+		printf("%s,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g",files[i],r->time,r->vol,r->PFR,r->LMAA,r->Tau_R,r->VF,r->TP,r->Q,r->Tau_N,r->ACH,r->Ea,r->NEV);
+		for(k=0;k<5;k++)
+		{
+			printf(",%g,%g,%g",r->FA_in[k],r->FA_out[k],r->FA_tur[k]);
+		}
+		printf(",%g,%g\n",r->C_canopy,r->U_E);
+	}
+}
+
+/********************************benchmark*********************************/
+
+typedef struct
+{
+	double *cell;
+	double *face;
+	int64_t *conn;
+} synth_mem;
+
+static void synth_snapshot(uint64_t n,umc_snap_header *h,snapshot *s,synth_mem *mem)
+{
+	//uniform grid over [0,8]x[0,10]x[0,6] with an even cell count per
+	//direction, so that the DOI planes x=4, y=5 and z=3 are grid planes
+	int nx,ny,nz,i,j,k;
+	double dx,dy,dz;
+	uint64_t nc,nf,c,f;
+	double *cell;
+
+	nx=2*(int)(0.5*cbrt((double)n*8*8/(10*6))+0.5);
+	ny=2*(int)(0.5*nx*10/8.+0.5);
+	nz=2*(int)(0.5*nx*6/8.+0.5);
+	if(nx<2) nx=2;
+	if(ny<2) ny=2;
+	if(nz<2) nz=2;
+	dx=8./nx;
+	dy=10./ny;
+	dz=6./nz;
+	nc=(uint64_t)nx*ny*nz;
+	nf=(uint64_t)(nx-1)*ny*nz+(uint64_t)nx*(ny-1)*nz+(uint64_t)nx*ny*(nz-1);
+
+	memset(h,0,sizeof(*h));
+	memset(s,0,sizeof(*s));
+	h->n_cells=nc;
+	h->n_faces=nf;
+	h->n_species=1;
+	mem->cell=cell=(double *)malloc(10*nc*sizeof(double));
+	mem->face=(double *)malloc(6*nf*sizeof(double));
+	mem->conn=(int64_t *)malloc(2*nf*sizeof(int64_t));
+	s->h=h;
+	s->cx=cell; s->cy=cell+nc; s->cz=cell+2*nc; s->vol=cell+3*nc;
+	s->u=cell+4*nc; s->v=cell+5*nc; s->w=cell+6*nc;
+	s->mut=cell+7*nc; s->rho=cell+8*nc; s->yi=cell+9*nc;
+	s->fc0=mem->conn; s->fc1=mem->conn+nf;
+	s->fax=mem->face; s->fay=mem->face+nf; s->faz=mem->face+2*nf;
+	s->fx=mem->face+3*nf; s->fy=mem->face+4*nf; s->fz=mem->face+5*nf;
+
+	c=0;
+	for(i=0;i<nx;i++) for(j=0;j<ny;j++) for(k=0;k<nz;k++,c++)
+	{
+		double x=(i+0.5)*dx,y=(j+0.5)*dy,z=(k+0.5)*dz;
+		cell[c]=x; cell[nc+c]=y; cell[2*nc+c]=z; cell[3*nc+c]=dx*dy*dz;
+		cell[4*nc+c]=pow(z/6,0.25);
+		cell[5*nc+c]=0.1*sin(x);
+		cell[6*nc+c]=0.05*cos(y);
+		cell[7*nc+c]=0.01;
+		cell[8*nc+c]=RHO;
+		cell[9*nc+c]=1e-3*exp(-0.1*(x+y+z));
+	}
+
+	f=0;
+	for(i=0;i<nx;i++) for(j=0;j<ny;j++) for(k=0;k<nz;k++)
+	{
+		int64_t c0=((int64_t)i*ny+j)*nz+k;
+		int d;
+		for(d=0;d<3;d++)
+		{
+			int64_t c1;
+			if((d==0 && i+1==nx) || (d==1 && j+1==ny) || (d==2 && k+1==nz)) continue;
+			c1=(d==0)?c0+(int64_t)ny*nz:(d==1)?c0+nz:c0+1;
+			mem->conn[f]=c0;
+			mem->conn[nf+f]=c1;
+			mem->face[f]=(d==0)?dy*dz:0;
+			mem->face[nf+f]=(d==1)?dx*dz:0;
+			mem->face[2*nf+f]=(d==2)?dx*dy:0;
+			mem->face[3*nf+f]=(i+0.5+(d==0)*0.5)*dx;
+			mem->face[4*nf+f]=(j+0.5+(d==1)*0.5)*dy;
+			mem->face[5*nf+f]=(k+0.5+(d==2)*0.5)*dz;
+			f++;
+		}
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+1e-9*ts.tv_nsec;
+}
+
+static int bench(uint64_t max_cells)
+{
+	uint64_t n;
+	int first=1;
+
+	printf("[\n");
+	for(n=10000;n<=max_cells;n*=10)
+	{
+		umc_snap_header h;
+		snapshot s;
+		synth_mem mem;
+		indices r;
+		double best=1e30,t0,t;
+		int rep,n_rep=(n<=100000)?20:3;
+
+		synth_snapshot(n,&h,&s,&mem);
+		compute_indices(&s,&r);	//warm-up
+		for(rep=0;rep<n_rep;rep++)
+		{
+			t0=now();
+			compute_indices(&s,&r);
+			t=now()-t0;
+			if(t<best) best=t;
+		}
+		printf("%s  {\"kernel\": \"indices\", \"cells\": %llu, \"faces\": %llu, \"repeats\": %d, \"best_s\": %.6e, \"cells_per_s\": %.4e, \"faces_per_s\": %.4e, \"PFR\": %.9g}",
+			first?"":",\n",(unsigned long long)h.n_cells,(unsigned long long)h.n_faces,n_rep,best,h.n_cells/best,h.n_faces/best,r.PFR);
+		first=0;
+		free(mem.cell);
+		free(mem.face);
+		free(mem.conn);
+	}
+	printf("\n]\n");
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,"usage: %s [-j threads] [-m M] [-s species] [-b XA XB YA YB ZA ZB] snapshot.umc ...\n",prog);
+	fprintf(stderr,"       %s --bench [max_cells]\n",prog);
+	fprintf(stderr,"       %s --merge snapshot.umc snapshot.umc.p0 snapshot.umc.p1 ...\n",prog);
+	exit(2);
+}
+
+int main(int argc,char **argv)
+{
+	int n_threads=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t *tid;
+	int i,failed=0;
+
+	if(argc>1 && strcmp(argv[1],"--bench")==0)
+	{
+		return bench((argc>2)?strtoull(argv[2],NULL,10):10000000ULL);
+	}
+	if(argc>1 && strcmp(argv[1],"--merge")==0)
+	{
+		char err[256];
+		if(argc<4) usage(argv[0]);
+		if(umc_snap_merge(argv[2],argv+3,argc-3,err,sizeof(err))!=0)
+		{
+			fprintf(stderr,"%s: %s\n",argv[0],err);
+			return 1;
+		}
+		return 0;
+	}
+
+	for(i=1;i<argc && argv[i][0]=='-';i++)
+	{
+		if(strcmp(argv[i],"-j")==0 && i+1<argc)
+		{
+			n_threads=atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i],"-m")==0 && i+1<argc)
+		{
+			cfg.m=atof(argv[++i]);
+		}
+		else if(strcmp(argv[i],"-s")==0 && i+1<argc)
+		{
+			char *end;
+			long sp=strtol(argv[++i],&end,10);
+			if(end==argv[i] || *end!='\0' || sp<0 || sp>INT_MAX)
+			{
+				fprintf(stderr,"%s: -s takes a non-negative species index\n",argv[0]);
+				usage(argv[0]);
+			}
+			cfg.species=(int)sp;
+		}
+		else if(strcmp(argv[i],"-b")==0 && i+6<argc)
+		{
+			cfg.xa=atof(argv[++i]);
+			cfg.xb=atof(argv[++i]);
+			cfg.ya=atof(argv[++i]);
+			cfg.yb=atof(argv[++i]);
+			cfg.za=atof(argv[++i]);
+			cfg.zb=atof(argv[++i]);
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+	files=argv+i;
+	n_files=argc-i;
+	if(n_files<=0)
+	{
+		usage(argv[0]);
+	}
+	if(n_threads<1)
+	{
+		n_threads=1;
+	}
+	if(n_threads>n_files)
+	{
+		n_threads=n_files;
+	}
+
+	results=(indices *)calloc(n_files,sizeof(indices));
+	tid=(pthread_t *)malloc(n_threads*sizeof(pthread_t));
+	atomic_init(&next_file,0);
+	for(i=0;i<n_threads;i++)
+	{
+		pthread_create(&tid[i],NULL,worker,NULL);
+	}
+	for(i=0;i<n_threads;i++)
+	{
+		pthread_join(tid[i],NULL);
+	}
+
+	print_results();
+	for(i=0;i<n_files;i++)
+	{
+		failed+=!results[i].ok;
+	}
+	free(tid);
+	free(results);
+	return failed?1:0;
+}
@@ -0,0 +1,243 @@
+/**************************************************************************
+                      benchmark of the UDF bodies
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Times the actual DEFINE_* functions on synthetic box meshes of 10^4 cells
+up to max_cells (default 10^7, about 4 GB), via the mock udf.h:
+1  inlet profiles (velocity_profile, k_profile, e_profile) of
+   udf_of_inlet.c, udf_of_tree.c and udf_of_urban_ventilation_indices.c,
+   evaluated on all interior faces so that the face count scales with the mesh;
+2  tree sources of udf_of_tree.c and the box sources (udf_source,
+   Pullation_1), called once per cell as the solver does;
+3  every index routine of udf_of_urban_ventilation_indices.c, in the order
+   of a post-processing session (geometry, indices, openings, raster, decay,
+   adaption marks).
+The three files are linked together with their profiles renamed by the
+build (inlet_*, tree_*, indices_*). Fast math is on, as in the solver.
+Mesh: [0,8]x[0,10]x[0,6] with cubic cells, deterministic fields; every
+kernel reports the best of several repeats as cells/s and faces/s of the
+whole mesh (profiles: of the faces evaluated), one JSON object per kernel
+and mesh size.
+Usage: bench_udf [max_cells] > bench_udf.json
+**************************************************************************/
+
+#include <time.h>
+#include "mock_mesh.h"
+
+typedef void (*profile_fn)(Thread *t,int i);
+typedef real (*source_fn)(cell_t c,Thread *t,real dS[],int eqn);
+typedef void (*demand_fn)(void);
+typedef void (*adjust_fn)(Domain *d);
+
+#define PROFILES(p) \
+	DEFINE_PROFILE(p##_velocity_profile,t,i); \
+	DEFINE_PROFILE(p##_k_profile,t,i); \
+	DEFINE_PROFILE(p##_e_profile,t,i); \
+	DEFINE_ON_DEMAND(p##_fastmath_on);
+PROFILES(inlet)
+PROFILES(tree)
+PROFILES(indices)
+DEFINE_SOURCE(x_momentum_source,c,t,dS,eqn);
+DEFINE_SOURCE(y_momentum_source,c,t,dS,eqn);
+DEFINE_SOURCE(z_momentum_source,c,t,dS,eqn);
+DEFINE_SOURCE(k_source,c,t,dS,eqn);
+DEFINE_SOURCE(e_source,c,t,dS,eqn);
+DEFINE_SOURCE(udf_source,c,t,dS,eqn);
+DEFINE_SOURCE(Pullation_1,c,t,dS,eqn);
+DEFINE_ON_DEMAND(vol_udf);
+DEFINE_ON_DEMAND(PFR_1_udf);
+DEFINE_ON_DEMAND(LMAA_1_udf);
+DEFINE_ON_DEMAND(Tau_R_1_udf);
+DEFINE_ON_DEMAND(VF_1_udf);
+DEFINE_ON_DEMAND(TP_1_udf);
+DEFINE_ON_DEMAND(Q_1_udf);
+DEFINE_ON_DEMAND(Tau_N_1_udf);
+DEFINE_ON_DEMAND(ACH_1_udf);
+DEFINE_ON_DEMAND(Ea_1_udf);
+DEFINE_ON_DEMAND(NEV_udf);
+DEFINE_ON_DEMAND(FA_roof_udf);
+DEFINE_ON_DEMAND(yCanopy_udf);
+DEFINE_ON_DEMAND(U_E_udf);
+DEFINE_ON_DEMAND(FA_setup_udf);
+DEFINE_ON_DEMAND(FA_udf);
+DEFINE_ON_DEMAND(raster_setup_udf);
+DEFINE_ON_DEMAND(raster_export_udf);
+DEFINE_ON_DEMAND(decay_result_udf);
+DEFINE_ADJUST(adapt_mark,domain);
+
+typedef struct
+{
+	const char *name;
+	profile_fn profile;
+	source_fn source;
+	demand_fn demand;
+	adjust_fn adjust;
+} kernel;
+
+static const kernel kernels[]=
+{
+	{"inlet.velocity_profile",inlet_velocity_profile,NULL,NULL,NULL},
+	{"inlet.k_profile",inlet_k_profile,NULL,NULL,NULL},
+	{"inlet.e_profile",inlet_e_profile,NULL,NULL,NULL},
+	{"tree.velocity_profile",tree_velocity_profile,NULL,NULL,NULL},
+	{"tree.k_profile",tree_k_profile,NULL,NULL,NULL},
+	{"tree.e_profile",tree_e_profile,NULL,NULL,NULL},
+	{"indices.velocity_profile",indices_velocity_profile,NULL,NULL,NULL},
+	{"indices.k_profile",indices_k_profile,NULL,NULL,NULL},
+	{"indices.e_profile",indices_e_profile,NULL,NULL,NULL},
+	{"tree.x_momentum_source",NULL,x_momentum_source,NULL,NULL},
+	{"tree.y_momentum_source",NULL,y_momentum_source,NULL,NULL},
+	{"tree.z_momentum_source",NULL,z_momentum_source,NULL,NULL},
+	{"tree.k_source",NULL,k_source,NULL,NULL},
+	{"tree.e_source",NULL,e_source,NULL,NULL},
+	{"source.udf_source",NULL,udf_source,NULL,NULL},
+	{"indices.Pullation_1",NULL,Pullation_1,NULL,NULL},
+	{"indices.vol_udf",NULL,NULL,vol_udf,NULL},
+	{"indices.PFR_1_udf",NULL,NULL,PFR_1_udf,NULL},
+	{"indices.LMAA_1_udf",NULL,NULL,LMAA_1_udf,NULL},
+	{"indices.Tau_R_1_udf",NULL,NULL,Tau_R_1_udf,NULL},
+	{"indices.VF_1_udf",NULL,NULL,VF_1_udf,NULL},
+	{"indices.TP_1_udf",NULL,NULL,TP_1_udf,NULL},
+	{"indices.Q_1_udf",NULL,NULL,Q_1_udf,NULL},
+	{"indices.Tau_N_1_udf",NULL,NULL,Tau_N_1_udf,NULL},
+	{"indices.ACH_1_udf",NULL,NULL,ACH_1_udf,NULL},
+	{"indices.Ea_1_udf",NULL,NULL,Ea_1_udf,NULL},
+	{"indices.NEV_udf",NULL,NULL,NEV_udf,NULL},
+	{"indices.FA_roof_udf",NULL,NULL,FA_roof_udf,NULL},
+	{"indices.yCanopy_udf",NULL,NULL,yCanopy_udf,NULL},
+	{"indices.U_E_udf",NULL,NULL,U_E_udf,NULL},
+	{"indices.FA_setup_udf",NULL,NULL,FA_setup_udf,NULL},
+	{"indices.FA_udf",NULL,NULL,FA_udf,NULL},
+	{"indices.raster_setup_udf",NULL,NULL,raster_setup_udf,NULL},
+	{"indices.raster_export_udf",NULL,NULL,raster_export_udf,NULL},
+	{"indices.decay_result_udf",NULL,NULL,decay_result_udf,NULL},
+	{"indices.adapt_mark",NULL,NULL,NULL,adapt_mark}
+};
+
+static real u_of(const real x[3]) {return pow(x[2]/6,0.25);}
+static real v_of(const real x[3]) {return 0.1*sin(x[0]);}
+static real w_of(const real x[3]) {return 0.05*cos(x[1]);}
+static real k_of(const real x[3]) {return 0.1+0.01*x[1];}
+static real d_of(const real x[3]) {return 0.05/(1+x[1]);}
+static real rho_of(const real x[3]) {(void)x; return 1.29;}
+static real mut_of(const real x[3]) {(void)x; return 0.01;}
+static real y_of(const real x[3]) {return 1e-3*exp(-0.1*(x[0]+x[1]+x[2]));}
+static real s_of(const real x[3]) {return fabs(sin(x[0])*cos(x[1]));}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+1e-9*ts.tv_nsec;
+}
+
+static double sink;	//keeps the source results alive
+
+static void run(const kernel *k,Domain *d)
+{
+	Thread *t=mock_cells();
+	cell_t c;
+	real dS[1],s=0;
+
+	if(k->profile!=NULL)
+	{
+		k->profile(mock_interior(),0);
+	}
+	else if(k->source!=NULL)
+	{
+		begin_c_loop(c,t)
+		{
+			s=s+k->source(c,t,dS,0);
+		}
+		end_c_loop(c,t)
+		sink=sink+s;
+	}
+	else if(k->demand!=NULL)
+	{
+		k->demand();
+	}
+	else
+	{
+		k->adjust(d);
+	}
+}
+
+static Domain *bench_mesh(long n)
+{
+	//cubic cells, even counts so that x=4, y=5 and z=3 are grid planes
+	const real lo[3]={0,0,0},hi[3]={8,10,6};
+	const int side[6]={THREAD_F_VINLET,THREAD_F_POUTLET,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	int m[3];
+	real h=cbrt(480./n);
+	Domain *d;
+	Thread *t;
+
+	m[0]=2*(int)(0.5*8/h+0.5);
+	m[1]=2*(int)(0.5*10/h+0.5);
+	m[2]=2*(int)(0.5*6/h+0.5);
+	d=mock_box(lo,hi,m,side);
+	t=mock_cells();
+	mock_fill(t,SV_U,u_of);
+	mock_fill(t,SV_V,v_of);
+	mock_fill(t,SV_W,w_of);
+	mock_fill(t,SV_K,k_of);
+	mock_fill(t,SV_D,d_of);
+	mock_fill(t,SV_DENSITY,rho_of);
+	mock_fill(t,SV_MU_T,mut_of);
+	mock_fill(t,SV_STRAIN_RATE_MAG,s_of);
+	mock_fill_species(t,0,y_of);
+	mock_alloc(t,SV_UDM_I);
+	mock_alloc_profile(mock_interior(),1);
+	return d;
+}
+
+int main(int argc,char *argv[])
+{
+	long max_cells=(argc>1)?atol(argv[1]):10000000L;
+	long n;
+	int first=1;
+	size_t j;
+
+	mock_quiet(1);
+	mock_set_species(1);
+	mock_set_udm(8);
+	inlet_fastmath_on();
+	tree_fastmath_on();
+	indices_fastmath_on();
+
+	printf("[\n");
+	for(n=10000;n<=max_cells;n*=10)
+	{
+		Domain *d=bench_mesh(n);
+		long nc=mock_cells()->n,nf=mock_interior()->n;
+		int rep,n_rep=(n<=100000)?20:3,s;
+		long nfk;
+		double best,t0,t;
+
+		for(s=0;s<6;s++)
+		{
+			nf=nf+mock_side(s)->n;
+		}
+		for(j=0;j<sizeof(kernels)/sizeof(kernels[0]);j++)
+		{
+			run(&kernels[j],d);	//warm-up, and setup for the kernels that follow
+			best=1e30;
+			for(rep=0;rep<n_rep;rep++)
+			{
+				t0=now();
+				run(&kernels[j],d);
+				t=now()-t0;
+				if(t<best) best=t;
+			}
+			if(best<=0) best=1e-9;
+			nfk=(kernels[j].profile!=NULL)?mock_interior()->n:nf;	//faces the profile ran on
+			printf("%s  {\"kernel\": \"%s\", \"cells\": %ld, \"faces\": %ld, \"repeats\": %d, \"best_s\": %.6e, \"cells_per_s\": %.4e, \"faces_per_s\": %.4e}",
+				first?"":",\n",kernels[j].name,nc,nfk,n_rep,best,nc/best,nfk/best);
+			first=0;
+		}
+		mock_free();
+	}
+	printf("\n]\n");
+	fprintf(stderr,"checksum %g\n",sink);
+	return 0;
+}
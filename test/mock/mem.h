@@ -0,0 +1,2 @@
+/* mock mem.h: everything used by the UDFs is in the mock udf.h */
+#include "udf.h"
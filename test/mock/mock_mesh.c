@@ -0,0 +1,457 @@
+/**************************************************************************
+                         synthetic mesh harness
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Box mesh, field storage and solver state behind the mock udf.h.
+**************************************************************************/
+
+#include <stdarg.h>
+#include "mock_mesh.h"
+
+#define MOCK_N_RP 16
+
+int n_spe=0;
+int mock_n_udm=0;
+real mock_time=0,mock_dt=1;
+int mock_iter=0,mock_step=0,mock_unsteady=0;
+
+static Domain domain;
+static Thread cells,interior,sides[6];
+static int nx,ny,nz;
+static real x0[3],dx[3];
+static Node node_tmp[64];	//rotating return buffer of C_NODE/F_NODE
+static int node_next=0;
+static int quiet=0;
+static struct {char name[64]; real value;} rp[MOCK_N_RP];
+static int n_rp=0;
+
+/******************************mesh build**********************************/
+
+static void thread_init(Thread *t,int id,int type,int n,int side)
+{
+	memset(t,0,sizeof(*t));
+	t->id=id;
+	t->type=type;
+	t->n=n;
+	t->side=side;
+	t->centroid=(real *)malloc(3*(size_t)(n>0?n:1)*sizeof(real));
+}
+
+static void face_init(Thread *t,int id,int type,int n,int side)
+{
+	int i;
+
+	thread_init(t,id,type,n,side);
+	t->area=(real *)malloc(3*(size_t)(n>0?n:1)*sizeof(real));
+	t->c0=(cell_t *)malloc((size_t)(n>0?n:1)*sizeof(cell_t));
+	t->c1=(cell_t *)malloc((size_t)(n>0?n:1)*sizeof(cell_t));
+	t->t0=&cells;
+	t->t1=(type==THREAD_F_INTERIOR)?&cells:NULL;
+	if(type!=THREAD_F_INTERIOR)
+	{
+		for(i=0;i<4;i++)
+		{
+			t->profile[i]=(real *)calloc((size_t)(n>0?n:1),sizeof(real));
+		}
+	}
+}
+
+static void face_set(Thread *t,face_t f,cell_t c0,cell_t c1,int axis,real sgn,int i,int j,int k)
+{
+	//face normal to axis through the lower corner (i,j,k) of cell c0 (+1 along axis for interior faces)
+	real *x=&t->centroid[3*(size_t)f],*a=&t->area[3*(size_t)f];
+	int d;
+
+	x[0]=x0[0]+(i+0.5)*dx[0];
+	x[1]=x0[1]+(j+0.5)*dx[1];
+	x[2]=x0[2]+(k+0.5)*dx[2];
+	x[axis]-=0.5*dx[axis];
+	for(d=0;d<3;d++)
+	{
+		a[d]=0;
+	}
+	a[axis]=sgn*dx[(axis+1)%3]*dx[(axis+2)%3];
+	t->c0[f]=c0;
+	t->c1[f]=c1;
+}
+
+static cell_t cell_of(int i,int j,int k)
+{
+	return ((cell_t)i*ny+j)*nz+k;
+}
+
+Domain *mock_box(const real lo[3],const real hi[3],const int n[3],const int side_type[6])
+{
+	int i,j,k,d,s;
+	face_t f;
+	cell_t c;
+	int nfx,nfy,nfz;
+
+	mock_free();
+	nx=n[0]; ny=n[1]; nz=n[2];
+	for(d=0;d<3;d++)
+	{
+		x0[d]=lo[d];
+		dx[d]=(hi[d]-lo[d])/n[d];
+	}
+
+	thread_init(&cells,2,THREAD_C_FLUID,nx*ny*nz,-1);
+	cells.volume=(real *)malloc((size_t)nx*ny*nz*sizeof(real));
+	for(i=0;i<nx;i++) for(j=0;j<ny;j++) for(k=0;k<nz;k++)
+	{
+		c=cell_of(i,j,k);
+		cells.centroid[3*(size_t)c]=x0[0]+(i+0.5)*dx[0];
+		cells.centroid[3*(size_t)c+1]=x0[1]+(j+0.5)*dx[1];
+		cells.centroid[3*(size_t)c+2]=x0[2]+(k+0.5)*dx[2];
+		cells.volume[c]=dx[0]*dx[1]*dx[2];
+	}
+
+	//interior faces: x, then y, then z normal
+	nfx=(nx-1)*ny*nz;
+	nfy=nx*(ny-1)*nz;
+	nfz=nx*ny*(nz-1);
+	face_init(&interior,1,THREAD_F_INTERIOR,nfx+nfy+nfz,-1);
+	for(i=0;i<nx;i++) for(j=0;j<ny;j++) for(k=0;k<nz;k++)
+	{
+		c=cell_of(i,j,k);
+		if(i+1<nx) face_set(&interior,(i*ny+j)*nz+k,c,cell_of(i+1,j,k),0,1,i+1,j,k);
+		if(j+1<ny) face_set(&interior,nfx+(i*(ny-1)+j)*nz+k,c,cell_of(i,j+1,k),1,1,i,j+1,k);
+		if(k+1<nz) face_set(&interior,nfx+nfy+(i*ny+j)*(nz-1)+k,c,cell_of(i,j,k+1),2,1,i,j,k+1);
+	}
+
+	//one boundary thread per side, areas out of the domain
+	face_init(&sides[MOCK_XMIN],3,side_type[MOCK_XMIN],ny*nz,MOCK_XMIN);
+	face_init(&sides[MOCK_XMAX],4,side_type[MOCK_XMAX],ny*nz,MOCK_XMAX);
+	face_init(&sides[MOCK_YMIN],5,side_type[MOCK_YMIN],nx*nz,MOCK_YMIN);
+	face_init(&sides[MOCK_YMAX],6,side_type[MOCK_YMAX],nx*nz,MOCK_YMAX);
+	face_init(&sides[MOCK_ZMIN],7,side_type[MOCK_ZMIN],nx*ny,MOCK_ZMIN);
+	face_init(&sides[MOCK_ZMAX],8,side_type[MOCK_ZMAX],nx*ny,MOCK_ZMAX);
+	for(j=0;j<ny;j++) for(k=0;k<nz;k++)
+	{
+		f=j*nz+k;
+		face_set(&sides[MOCK_XMIN],f,cell_of(0,j,k),-1,0,-1,0,j,k);
+		face_set(&sides[MOCK_XMAX],f,cell_of(nx-1,j,k),-1,0,1,nx,j,k);
+	}
+	for(i=0;i<nx;i++) for(k=0;k<nz;k++)
+	{
+		f=i*nz+k;
+		face_set(&sides[MOCK_YMIN],f,cell_of(i,0,k),-1,1,-1,i,0,k);
+		face_set(&sides[MOCK_YMAX],f,cell_of(i,ny-1,k),-1,1,1,i,ny,k);
+	}
+	for(i=0;i<nx;i++) for(j=0;j<ny;j++)
+	{
+		f=i*ny+j;
+		face_set(&sides[MOCK_ZMIN],f,cell_of(i,j,0),-1,2,-1,i,j,0);
+		face_set(&sides[MOCK_ZMAX],f,cell_of(i,j,nz-1),-1,2,1,i,j,nz);
+	}
+
+	domain.c=&cells;
+	domain.f=&interior;
+	interior.next=&sides[0];
+	for(s=0;s<5;s++)
+	{
+		sides[s].next=&sides[s+1];
+	}
+	return &domain;
+}
+
+static void thread_free(Thread *t)
+{
+	int i;
+
+	for(i=0;i<SV_MAX;i++) free(t->storage[i]);
+	for(i=0;i<4;i++) free(t->profile[i]);
+	free(t->centroid);
+	free(t->volume);
+	free(t->area);
+	free(t->c0);
+	free(t->c1);
+	memset(t,0,sizeof(*t));
+}
+
+void mock_free(void)
+{
+	int s;
+
+	thread_free(&cells);
+	thread_free(&interior);
+	for(s=0;s<6;s++)
+	{
+		thread_free(&sides[s]);
+	}
+	domain.c=NULL;
+	domain.f=NULL;
+}
+
+Thread *mock_cells(void)
+{
+	return &cells;
+}
+
+Thread *mock_interior(void)
+{
+	return &interior;
+}
+
+Thread *mock_side(int side)
+{
+	return &sides[side];
+}
+
+Domain *Get_Domain(int id)
+{
+	(void)id;
+	return &domain;
+}
+
+Thread *Lookup_Thread(Domain *d,int id)
+{
+	Thread *t;
+
+	thread_loop_c(t,d)
+	{
+		if(t->id==id) return t;
+	}
+	thread_loop_f(t,d)
+	{
+		if(t->id==id) return t;
+	}
+	return NULL;
+}
+
+/******************************connectivity********************************/
+
+void mock_copy3(real *dst,const real *src)
+{
+	dst[0]=src[0];
+	dst[1]=src[1];
+	dst[2]=src[2];
+}
+
+face_t mock_cell_face(cell_t c,Thread *t,int n,Thread **tf)
+{
+	//face n of cell c: 0 x-, 1 x+, 2 y-, 3 y+, 4 z-, 5 z+
+	int i=c/(ny*nz),j=(c/nz)%ny,k=c%nz;
+	int nfx=(nx-1)*ny*nz,nfy=nx*(ny-1)*nz;
+	Thread *r=&interior;
+	face_t f=-1;
+	(void)t;
+
+	switch(n)
+	{
+		case 0: if(i==0) {r=&sides[MOCK_XMIN]; f=j*nz+k;} else f=((i-1)*ny+j)*nz+k; break;
+		case 1: if(i==nx-1) {r=&sides[MOCK_XMAX]; f=j*nz+k;} else f=(i*ny+j)*nz+k; break;
+		case 2: if(j==0) {r=&sides[MOCK_YMIN]; f=i*nz+k;} else f=nfx+(i*(ny-1)+j-1)*nz+k; break;
+		case 3: if(j==ny-1) {r=&sides[MOCK_YMAX]; f=i*nz+k;} else f=nfx+(i*(ny-1)+j)*nz+k; break;
+		case 4: if(k==0) {r=&sides[MOCK_ZMIN]; f=i*ny+j;} else f=nfx+nfy+(i*ny+j)*(nz-1)+k-1; break;
+		default: if(k==nz-1) {r=&sides[MOCK_ZMAX]; f=i*ny+j;} else f=nfx+nfy+(i*ny+j)*(nz-1)+k; break;
+	}
+	if(tf!=NULL) *tf=r;
+	return f;
+}
+
+Thread *mock_cell_face_thread(cell_t c,Thread *t,int n)
+{
+	Thread *r;
+	mock_cell_face(c,t,n,&r);
+	return r;
+}
+
+static Node *node_at(int i,int j,int k)
+{
+	Node *v=&node_tmp[node_next];
+	node_next=(node_next+1)%64;
+	v->x[0]=x0[0]+i*dx[0];
+	v->x[1]=x0[1]+j*dx[1];
+	v->x[2]=x0[2]+k*dx[2];
+	return v;
+}
+
+Node *mock_cell_node(cell_t c,Thread *t,int n)
+{
+	int i=c/(ny*nz),j=(c/nz)%ny,k=c%nz;
+	(void)t;
+	return node_at(i+(n&1),j+((n>>1)&1),k+((n>>2)&1));
+}
+
+Node *mock_face_node(face_t f,Thread *t,int n)
+{
+	//corners in order around the face, from the lower corner
+	static const int du[4]={0,1,1,0},dv[4]={0,0,1,1};
+	real *x=&t->centroid[3*(size_t)f],*a=&t->area[3*(size_t)f];
+	int ax=(a[0]!=0)?0:(a[1]!=0)?1:2,u=(ax+1)%3,v=(ax+2)%3;
+	int g[3];
+
+	g[ax]=(int)floor((x[ax]-x0[ax])/dx[ax]+0.5);
+	g[u]=(int)floor((x[u]-x0[u])/dx[u])+du[n];
+	g[v]=(int)floor((x[v]-x0[v])/dx[v])+dv[n];
+	return node_at(g[0],g[1],g[2]);
+}
+
+/*********************************fields***********************************/
+
+static size_t sv_width(Thread *t,int sv)
+{
+	//reals per element
+	switch(sv)
+	{
+		case SV_Y: return n_spe>0?n_spe:1;
+		case SV_UDM_I: return mock_n_udm>0?mock_n_udm:1;
+		case SV_U_G: case SV_V_G: case SV_W_G: return 3;
+		case SV_Y_G: return 3*(size_t)(n_spe>0?n_spe:1);
+		default: (void)t; return 1;
+	}
+}
+
+void mock_alloc(Thread *t,int sv)
+{
+	if(t->storage[sv]==NULL)
+	{
+		t->storage[sv]=calloc(sv_width(t,sv)*(size_t)(t->n>0?t->n:1),sizeof(real));
+	}
+}
+
+void mock_alloc_profile(Thread *t,int n)
+{
+	//profile columns 0..n-1, e.g. on the interior thread to time DEFINE_PROFILE bodies on many faces
+	int i;
+
+	for(i=0;i<n && i<4;i++)
+	{
+		if(t->profile[i]==NULL)
+		{
+			t->profile[i]=(real *)calloc((size_t)(t->n>0?t->n:1),sizeof(real));
+		}
+	}
+}
+
+void mock_fill(Thread *t,int sv,mock_scalar_fn fn)
+{
+	int e;
+
+	mock_alloc(t,sv);
+	for(e=0;e<t->n;e++)
+	{
+		MOCK_R(t,sv)[e]=fn(&t->centroid[3*(size_t)e]);
+	}
+}
+
+void mock_fill_species(Thread *t,int i,mock_scalar_fn fn)
+{
+	int e;
+
+	mock_alloc(t,SV_Y);
+	for(e=0;e<t->n;e++)
+	{
+		MOCK_R(t,SV_Y)[(size_t)i*t->n+e]=fn(&t->centroid[3*(size_t)e]);
+	}
+}
+
+void mock_fill_vector(Thread *t,int sv,mock_vector_fn fn)
+{
+	int e;
+
+	mock_alloc(t,sv);
+	for(e=0;e<(int)(t->n*(sv_width(t,sv)/3));e++)
+	{
+		fn(&t->centroid[3*(size_t)(e%t->n)],&MOCK_R(t,sv)[3*(size_t)e]);
+	}
+}
+
+void mock_fill_all(int sv,mock_scalar_fn fn)
+{
+	//cells and every boundary thread, from the centroids
+	int s;
+
+	mock_fill(&cells,sv,fn);
+	for(s=0;s<6;s++)
+	{
+		mock_fill(&sides[s],sv,fn);
+	}
+}
+
+void mock_set_species(int n)
+{
+	n_spe=n;
+}
+
+void mock_set_udm(int n)
+{
+	mock_n_udm=n;
+}
+
+/******************************solver state********************************/
+
+void mock_quiet(int on)
+{
+	quiet=on;
+}
+
+void Message(const char *fmt,...)
+{
+	va_list ap;
+
+	if(quiet) return;
+	va_start(ap,fmt);
+	vprintf(fmt,ap);
+	va_end(ap);
+}
+
+void Error(const char *fmt,...)
+{
+	va_list ap;
+
+	va_start(ap,fmt);
+	vfprintf(stderr,fmt,ap);
+	va_end(ap);
+	exit(1);
+}
+
+void mock_rp_set(const char *name,real value)
+{
+	int i;
+
+	for(i=0;i<n_rp && strcmp(rp[i].name,name)!=0;i++);
+	if(i==n_rp)
+	{
+		if(n_rp==MOCK_N_RP) Error("mock_rp_set: too many variables\n");
+		strncpy(rp[i].name,name,sizeof(rp[i].name)-1);
+		n_rp++;
+	}
+	rp[i].value=value;
+}
+
+int RP_Variable_Exists_P(const char *name)
+{
+	int i;
+
+	if(strcmp(name,"rp-unsteady?")==0) return 1;
+	for(i=0;i<n_rp;i++)
+	{
+		if(strcmp(rp[i].name,name)==0) return 1;
+	}
+	return 0;
+}
+
+real RP_Get_Real(const char *name)
+{
+	int i;
+
+	for(i=0;i<n_rp;i++)
+	{
+		if(strcmp(rp[i].name,name)==0) return rp[i].value;
+	}
+	Error("RP_Get_Real: %s is not defined\n",name);
+	return 0;
+}
+
+int RP_Get_Integer(const char *name)
+{
+	return (int)RP_Get_Real(name);
+}
+
+int RP_Get_Boolean(const char *name)
+{
+	if(strcmp(name,"rp-unsteady?")==0) return mock_unsteady;
+	return RP_Get_Real(name)!=0;
+}
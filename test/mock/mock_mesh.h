@@ -0,0 +1,41 @@
+/**************************************************************************
+                         synthetic mesh harness
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Runtime behind the mock udf.h: a structured box mesh of nx*ny*nz hex
+cells in one fluid thread (ID 2), one interior face thread (ID 1) and one
+boundary face thread per box side (IDs 3..8 for x-, x+, y-, y+, z-, z+),
+with analytic fields set from the cell or face centroids. Cells are
+numbered c=(i*ny+j)*nz+k; interior faces point towards +x, +y or +z.
+Tests and benchmarks build the mesh, fill the fields they need and call
+the DEFINE_* functions of a UDF file directly.
+**************************************************************************/
+
+#ifndef MOCK_MESH_H
+#define MOCK_MESH_H
+
+#include "udf.h"
+
+enum {MOCK_XMIN,MOCK_XMAX,MOCK_YMIN,MOCK_YMAX,MOCK_ZMIN,MOCK_ZMAX};
+
+typedef real (*mock_scalar_fn)(const real x[3]);
+typedef void (*mock_vector_fn)(const real x[3],real g[3]);
+
+Domain *mock_box(const real lo[3],const real hi[3],const int n[3],const int side_type[6]);
+void mock_free(void);
+Thread *mock_cells(void);
+Thread *mock_interior(void);
+Thread *mock_side(int side);
+
+void mock_alloc(Thread *t,int sv);
+void mock_alloc_profile(Thread *t,int n);
+void mock_fill(Thread *t,int sv,mock_scalar_fn fn);
+void mock_fill_species(Thread *t,int i,mock_scalar_fn fn);
+void mock_fill_vector(Thread *t,int sv,mock_vector_fn fn);
+void mock_fill_all(int sv,mock_scalar_fn fn);
+void mock_set_species(int n);
+void mock_set_udm(int n);
+void mock_rp_set(const char *name,real value);
+void mock_quiet(int on);
+
+#endif
@@ -0,0 +1,241 @@
+/**************************************************************************
+                        mock Fluent UDF environment
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Stand-in for the udf.h of Fluent, so that the UDF files of this repository
+compile unchanged on plain Linux and run against an in-memory mesh built by
+the runtime in mock_mesh.c (see mock_mesh.h). Only the part of the UDF API
+used here is provided, with the Fluent conventions:
+1  face area vectors point from c0 to c1, out of the domain on boundaries;
+2  field storage of a thread is NULL until a test allocates it, so the
+   THREAD_STORAGE checks of the UDFs behave as in the solver;
+3  serial process: no exterior cells, reductions return their argument.
+Not for use inside Fluent.
+**************************************************************************/
+
+#ifndef MOCK_UDF_H
+#define MOCK_UDF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef double real;
+typedef int cell_t;
+typedef int face_t;
+
+#define ND_ND 3
+#define RP_2D 0
+#define RP_3D 1
+
+/*****************************threads & domain*****************************/
+
+enum
+{
+	SV_U,SV_V,SV_W,SV_P,SV_K,SV_D,SV_DENSITY,SV_MU_T,SV_MU_LAM,SV_T,
+	SV_Y,                        //n_spe arrays, species by species
+	SV_UDM_I,                    //N_UDM arrays
+	SV_U_G,SV_V_G,SV_W_G,        //3 per element
+	SV_Y_G,                      //3 per element and species
+	SV_STRAIN_RATE_MAG,          //derived in Fluent, stored by the mock
+	SV_MAX
+};
+
+enum
+{
+	THREAD_C_FLUID=1,THREAD_C_SOLID,
+	THREAD_F_INTERIOR,THREAD_F_WALL,THREAD_F_PINLET,THREAD_F_POUTLET,
+	THREAD_F_SYMMETRY,THREAD_F_VINLET,THREAD_F_OUTFLOW
+};
+
+typedef struct node_struct
+{
+	real x[3];
+} Node;
+
+typedef struct thread_struct
+{
+	int id;
+	int type;
+	int n;                        //elements
+	struct thread_struct *next;
+	void *storage[SV_MAX];
+	real *centroid;               //3 per element
+	real *volume;                 //cells
+	real *area;                   //faces: 3 per face
+	cell_t *c0,*c1;               //faces: neighbour cells, c1=-1 on boundaries
+	struct thread_struct *t0,*t1; //faces: neighbour cell threads
+	real *profile[4];             //boundary faces: F_PROFILE(f,t,i)
+	int side;                     //mock: box side 0..5 of a boundary thread, -1 otherwise
+} Thread;
+
+typedef struct domain_struct
+{
+	Thread *c;                    //cell threads
+	Thread *f;                    //face threads
+} Domain;
+
+Domain *Get_Domain(int id);
+Thread *Lookup_Thread(Domain *d,int id);
+
+#define THREAD_ID(t) ((t)->id)
+#define THREAD_TYPE(t) ((t)->type)
+#define THREAD_STORAGE(t,sv) ((t)->storage[sv])
+#define THREAD_N_ELEMENTS(t) ((t)->n)
+#define THREAD_N_ELEMENTS_INT(t) ((t)->n)
+#define THREAD_N_ELEMENTS_EXT(t) 0
+#define FLUID_THREAD_P(t) ((t)->type==THREAD_C_FLUID)
+#define SOLID_THREAD_P(t) ((t)->type==THREAD_C_SOLID)
+#define BOUNDARY_FACE_THREAD_P(t) ((t)->type!=THREAD_F_INTERIOR)
+#define NULLP(p) ((p)==NULL)
+#define NNULLP(p) ((p)!=NULL)
+
+#define thread_loop_c(t,d) for((t)=(d)->c;(t)!=NULL;(t)=(t)->next)
+#define thread_loop_f(t,d) for((t)=(d)->f;(t)!=NULL;(t)=(t)->next)
+#define begin_c_loop(c,t) for((c)=0;(c)<(t)->n;(c)++)
+#define end_c_loop(c,t)
+#define begin_c_loop_int(c,t) for((c)=0;(c)<(t)->n;(c)++)
+#define end_c_loop_int(c,t)
+#define begin_c_loop_all(c,t) for((c)=0;(c)<(t)->n;(c)++)
+#define end_c_loop_all(c,t)
+#define begin_f_loop(f,t) for((f)=0;(f)<(t)->n;(f)++)
+#define end_f_loop(f,t)
+#define PRINCIPAL_FACE_P(f,t) 1
+
+/*******************************geometry***********************************/
+
+#define C_CENTROID(x,c,t) mock_copy3(x,&(t)->centroid[3*(size_t)(c)])
+#define F_CENTROID(x,f,t) mock_copy3(x,&(t)->centroid[3*(size_t)(f)])
+#define F_AREA(a,f,t) mock_copy3(a,&(t)->area[3*(size_t)(f)])
+#define C_VOLUME(c,t) ((t)->volume[c])
+#define F_C0(f,t) ((t)->c0[f])
+#define F_C1(f,t) ((t)->c1[f])
+#define F_C0_THREAD(f,t) ((t)->t0)
+#define F_C1_THREAD(f,t) ((t)->t1)
+
+#define c_face_loop(c,t,n) for((n)=0;(n)<6;(n)++)
+#define C_NFACES(c,t) 6
+#define C_FACE(c,t,n) mock_cell_face(c,t,n,NULL)
+#define C_FACE_THREAD(c,t,n) mock_cell_face_thread(c,t,n)
+#define c_node_loop(c,t,n) for((n)=0;(n)<8;(n)++)
+#define C_NNODES(c,t) 8
+#define C_NODE(c,t,n) mock_cell_node(c,t,n)
+#define f_node_loop(f,t,n) for((n)=0;(n)<4;(n)++)
+#define F_NNODES(f,t) 4
+#define F_NODE(f,t,n) mock_face_node(f,t,n)
+#define NODE_X(v) ((v)->x[0])
+#define NODE_Y(v) ((v)->x[1])
+#define NODE_Z(v) ((v)->x[2])
+#define NODE_COORD(v) ((v)->x)
+
+void mock_copy3(real *dst,const real *src);
+face_t mock_cell_face(cell_t c,Thread *t,int n,Thread **tf);
+Thread *mock_cell_face_thread(cell_t c,Thread *t,int n);
+Node *mock_cell_node(cell_t c,Thread *t,int n);
+Node *mock_face_node(face_t f,Thread *t,int n);
+
+/********************************fields************************************/
+
+#define MOCK_R(t,sv) ((real *)(t)->storage[sv])
+#define C_U(c,t) MOCK_R(t,SV_U)[c]
+#define C_V(c,t) MOCK_R(t,SV_V)[c]
+#define C_W(c,t) MOCK_R(t,SV_W)[c]
+#define C_P(c,t) MOCK_R(t,SV_P)[c]
+#define C_K(c,t) MOCK_R(t,SV_K)[c]
+#define C_D(c,t) MOCK_R(t,SV_D)[c]
+#define C_R(c,t) MOCK_R(t,SV_DENSITY)[c]
+#define C_MU_T(c,t) MOCK_R(t,SV_MU_T)[c]
+#define C_MU_L(c,t) MOCK_R(t,SV_MU_LAM)[c]
+#define C_T(c,t) MOCK_R(t,SV_T)[c]
+#define C_YI(c,t,i) MOCK_R(t,SV_Y)[(size_t)(i)*(t)->n+(c)]
+#define C_UDMI(c,t,i) MOCK_R(t,SV_UDM_I)[(size_t)(i)*(t)->n+(c)]
+#define C_U_G(c,t) (&MOCK_R(t,SV_U_G)[3*(size_t)(c)])
+#define C_V_G(c,t) (&MOCK_R(t,SV_V_G)[3*(size_t)(c)])
+#define C_W_G(c,t) (&MOCK_R(t,SV_W_G)[3*(size_t)(c)])
+#define C_YI_G(c,t,i) (&MOCK_R(t,SV_Y_G)[3*((size_t)(i)*(t)->n+(c))])
+#define C_STRAIN_RATE_MAG(c,t) MOCK_R(t,SV_STRAIN_RATE_MAG)[c]
+
+#define F_U(f,t) MOCK_R(t,SV_U)[f]
+#define F_V(f,t) MOCK_R(t,SV_V)[f]
+#define F_W(f,t) MOCK_R(t,SV_W)[f]
+#define F_P(f,t) MOCK_R(t,SV_P)[f]
+#define F_R(f,t) MOCK_R(t,SV_DENSITY)[f]
+#define F_T(f,t) MOCK_R(t,SV_T)[f]
+#define F_YI(f,t,i) MOCK_R(t,SV_Y)[(size_t)(i)*(t)->n+(f)]
+#define F_UDMI(f,t,i) MOCK_R(t,SV_UDM_I)[(size_t)(i)*(t)->n+(f)]
+#define F_PROFILE(f,t,i) ((t)->profile[i][f])
+
+extern int n_spe;
+extern int mock_n_udm;
+#define N_UDM mock_n_udm
+
+/*****************************vectors & misc*******************************/
+
+#define NV_VEC(a) a[ND_ND]
+#define NV_MAG(a) sqrt((a)[0]*(a)[0]+(a)[1]*(a)[1]+(a)[2]*(a)[2])
+#define NV_MAG2(a) ((a)[0]*(a)[0]+(a)[1]*(a)[1]+(a)[2]*(a)[2])
+#define NV_DOT(a,b) ((a)[0]*(b)[0]+(a)[1]*(b)[1]+(a)[2]*(b)[2])
+#define NV_D(a,eq,x,y,z) ((a)[0] eq (x),(a)[1] eq (y),(a)[2] eq (z))
+#define ROUND(x) floor((x)+0.5)
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define ABS(a) ((a)<0?-(a):(a))
+#define SQR(a) ((a)*(a))
+#define TRUE 1
+#define FALSE 0
+
+void Message(const char *fmt,...);
+void Error(const char *fmt,...);
+
+/*****************************solver state*********************************/
+
+extern real mock_time,mock_dt;
+extern int mock_iter,mock_step,mock_unsteady;
+#define CURRENT_TIME mock_time
+#define CURRENT_TIMESTEP mock_dt
+#define N_TIME mock_step
+#define N_ITER mock_iter
+
+int RP_Get_Boolean(const char *name);
+int RP_Get_Integer(const char *name);
+real RP_Get_Real(const char *name);
+int RP_Variable_Exists_P(const char *name);
+
+/*******************************parallel***********************************/
+
+/* serial process: RP_HOST and RP_NODE stay undefined (0 in #if) */
+#define I_AM_NODE_ZERO_P 1
+#define I_AM_NODE_HOST_P 0
+#define myid 0
+#define node_zero 0
+#define compute_node_count 1
+#define PRF_GRSUM1(x) (x)
+#define PRF_GISUM1(x) (x)
+#define PRF_GRHIGH1(x) (x)
+#define PRF_GRLOW1(x) (x)
+#define PRF_GIHIGH1(x) (x)
+#define PRF_GILOW1(x) (x)
+#define PRF_GRSUM(x,n,w)
+#define PRF_GISUM(x,n,w)
+#define PRF_GRLOW(x,n,w)
+#define PRF_GILOW(x,n,w)
+#define PRF_GSYNC()
+
+/*****************************UDF definitions******************************/
+
+#define DEFINE_PROFILE(name,t,i) void name(Thread *t,int i)
+#define DEFINE_SOURCE(name,c,t,dS,eqn) real name(cell_t c,Thread *t,real dS[],int eqn)
+#define DEFINE_ON_DEMAND(name) void name(void)
+#define DEFINE_ADJUST(name,d) void name(Domain *d)
+#define DEFINE_INIT(name,d) void name(Domain *d)
+#define DEFINE_EXECUTE_AT_END(name) void name(void)
+#define DEFINE_EXECUTE_ON_LOADING(name,lib) void name(char *lib)
+#define DEFINE_RW_FILE(name,fp) void name(FILE *fp)
+
+#endif
@@ -0,0 +1,12 @@
+# offline_residence_time must print the same distributions and means for any
+# number of worker threads (run by CTest on the snapshot of test_snapshot).
+foreach(j 1 4)
+	execute_process(COMMAND ${RTD} -j ${j} -n 50000 -t 50 snapshot.umc
+		OUTPUT_VARIABLE out_${j} RESULT_VARIABLE rc)
+	if(NOT rc EQUAL 0)
+		message(FATAL_ERROR "offline_residence_time -j ${j} failed: ${rc}")
+	endif()
+endforeach()
+if(NOT out_1 STREQUAL out_4)
+	message(FATAL_ERROR "output differs between -j 1 and -j 4:\n${out_1}\n${out_4}")
+endif()
@@ -0,0 +1,81 @@
+/**************************************************************************
+                 test of udf_of_particle_deposition.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Ground deposition in a 4 m box with 1 m cells, uniform k, ground as the
+only wall:
+1  deposition_adjust gives every ground cell the same positive conductance
+   per bin, larger for PM10 (settling) than for PM2.5, and 0 elsewhere;
+2  without k storage (laminar) or with a solid cell zone next to the wall
+   no conductance is written and nothing is read from missing storage.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_ADJUST(deposition_adjust,domain);
+
+static real k_of(const real x[3]) {(void)x; return 0.1;}
+
+static int conductances(Thread *t,int j,real *ground)
+{
+	//1 if the ground layer has one value and all other cells are 0
+	cell_t c;
+	real x[3];
+	int ok=1;
+
+	*ground=-1;
+	begin_c_loop(c,t)
+	{
+		C_CENTROID(x,c,t);
+		if(x[2]>1)
+		{
+			ok=ok && C_UDMI(c,t,j)==0;
+		}
+		else
+		{
+			if(*ground<0) *ground=C_UDMI(c,t,j);
+			ok=ok && C_UDMI(c,t,j)==*ground;
+		}
+	}
+	end_c_loop(c,t)
+	return ok;
+}
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={4,4,4};
+	const int n[3]={4,4,4};
+	const int side[6]={THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	Domain *d;
+	Thread *t;
+	real g[3];
+
+	mock_quiet(1);
+	mock_set_udm(11);
+	d=mock_box(lo,hi,n,side);
+	t=mock_cells();
+	mock_alloc(t,SV_UDM_I);
+
+	//2 no k storage: nothing deposited
+	deposition_adjust(d);
+	check_true("no k: conductances 0",conductances(t,8,&g[0]) && g[0]==0);
+
+	//1 ground layer
+	mock_fill(t,SV_K,k_of);
+	deposition_adjust(d);
+	check_true("PM1 only on the ground layer",conductances(t,8,&g[0]));
+	check_true("PM2.5 only on the ground layer",conductances(t,9,&g[1]));
+	check_true("PM10 only on the ground layer",conductances(t,10,&g[2]));
+	check_true("ground conductances positive",g[0]>0 && g[1]>0 && g[2]>0);
+	check_true("PM10 settles faster than PM2.5",g[2]>g[1]);
+
+	//2 solid zone next to the wall
+	t->type=THREAD_C_SOLID;
+	deposition_adjust(d);
+	check_true("solid zone: conductances unchanged",conductances(t,10,&g[0]) && g[0]==g[2]);
+	t->type=THREAD_C_FLUID;
+
+	mock_free();
+	TEST_END("test_deposition");
+}
@@ -0,0 +1,83 @@
+/**************************************************************************
+                  test of udf_of_facade_pressure.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+One opening of 2 m x 2 m on the wall x=0 of [0,4]^3 with 1 m cells,
+wall pressure 0.5*RHO*UREF^2 and |U|=2 in the cells:
+1  facade_cp gives the opening its 4 m2 of wall faces, Cp=1 and |U|=2;
+2  with a solid cell zone next to the wall the faces are skipped and the
+   opening is written without wall faces instead of reading the velocity
+   of the solid cells.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_ON_DEMAND(facade_setup);
+DEFINE_ON_DEMAND(facade_cp);
+
+static real u_of(const real x[3]) {(void)x; return 2;}
+static real zero_of(const real x[3]) {(void)x; return 0;}
+static real q_of(const real x[3]) {(void)x; return 0.5*1.29*7.84*7.84;}
+
+static int opening_row(double v[3])
+{
+	//area, Cp and |U| of the last row of facade_cp.txt
+	FILE *fp=fopen("facade_cp.txt","r");
+	char line[256],s[2][32];
+	int id,n=0;
+
+	if(fp==NULL) return 0;
+	while(fgets(line,sizeof(line),fp)!=NULL)
+	{
+		if(line[0]=='#') continue;
+		n=(sscanf(line,"%d %lf %31s %31s",&id,&v[0],s[0],s[1])==4);
+		if(n)
+		{
+			v[1]=atof(s[0]);
+			v[2]=atof(s[1]);
+		}
+	}
+	fclose(fp);
+	return n;
+}
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={4,4,4};
+	const int n[3]={4,4,4};
+	const int side[6]={THREAD_F_WALL,THREAD_F_POUTLET,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	FILE *fp;
+	double v[3];
+
+	mock_quiet(1);
+	mock_box(lo,hi,n,side);
+	mock_fill(mock_cells(),SV_U,u_of);
+	mock_fill(mock_cells(),SV_V,zero_of);
+	mock_fill(mock_cells(),SV_W,zero_of);
+	mock_fill(mock_side(MOCK_XMIN),SV_P,q_of);
+	mock_fill(mock_side(MOCK_ZMIN),SV_P,q_of);
+	fp=fopen("openings.txt","w");
+	fprintf(fp,"7 -0.01 1 1 0.01 3 3\n");
+	fclose(fp);
+	remove("facade_cp.txt");
+
+	//1 fluid next to the wall
+	facade_setup();
+	facade_cp();
+	check_true("opening row",opening_row(v));
+	check_close("opening area",v[0],4,1e-12);
+	check_close("opening Cp",v[1],1,1e-6);
+	check_close("opening |U|",v[2],2,1e-12);
+
+	//2 solid zone next to the wall
+	mock_cells()->type=THREAD_C_SOLID;
+	remove("facade_cp.txt");
+	facade_cp();
+	check_true("solid zone: opening row",opening_row(v));
+	check_close("solid zone: no wall faces",v[0],0,0);
+	mock_cells()->type=THREAD_C_FLUID;
+
+	mock_free();
+	TEST_END("test_facade");
+}
@@ -0,0 +1,74 @@
+/**************************************************************************
+                       test of udf_fastmath.h
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+fm_exp, fm_log and fm_pow against libm, failing on any tolerance breach:
+1  fm_exp on [-708,709.7] within 1e-8 relative;
+2  fm_exp is 0 below -708 and +inf from the libm overflow threshold on;
+3  fm_log on [1e-300,1e300] within 1e-8 absolute (relative away from 1);
+4  fm_pow for x in [1e-300,1e300], a in [0.1,0.5] within 1e-8 relative,
+   0 for x<=0.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "udf_fastmath.h"
+#include "test_util.h"
+
+#define TOL 1e-8
+
+int main(void)
+{
+	double x,a,e,emax=0;
+	int i,j;
+
+	//1 sweep of exp over its whole finite, normal range
+	for(i=0;i<=2000000;i++)
+	{
+		x=-708+1417.7*i/2000000.;
+		e=fabs(fm_exp(x)/exp(x)-1);
+		if(e>emax) emax=e;
+	}
+	printf("fm_exp max relative error %.3g\n",emax);
+	check_true("fm_exp on [-708,709.7]",emax<TOL);
+	check_close("fm_exp(0)",fm_exp(0),1,TOL);
+	check_close("fm_exp(709.78)",fm_exp(709.78),exp(709.78),TOL);
+
+	//2 limits
+	check_true("fm_exp(-708.01)==0",fm_exp(-708.01)==0);
+	check_true("fm_exp(-1e6)==0",fm_exp(-1e6)==0);
+	check_true("fm_exp(-1e300)==0",fm_exp(-1e300)==0);
+	check_true("fm_exp(709.79)==inf",isinf(fm_exp(709.79)) && fm_exp(709.79)>0);
+	check_true("fm_exp(1e6)==inf",isinf(fm_exp(1e6)) && fm_exp(1e6)>0);
+	check_true("fm_exp(1e300)==inf",isinf(fm_exp(1e300)) && fm_exp(1e300)>0);
+
+	//3 log
+	emax=0;
+	for(i=0;i<=600000;i++)
+	{
+		x=pow(10,-300+600*i/600000.);
+		e=fabs(fm_log(x)-log(x))/((fabs(log(x))>1)?fabs(log(x)):1);
+		if(e>emax) emax=e;
+	}
+	printf("fm_log max error %.3g\n",emax);
+	check_true("fm_log on [1e-300,1e300]",emax<TOL);
+
+	//4 pow as used by the profiles
+	emax=0;
+	for(j=0;j<=40;j++)
+	{
+		a=0.1+0.01*j;
+		for(i=0;i<=100000;i++)
+		{
+			x=pow(10,-300+600*i/100000.);
+			e=fabs(fm_pow(x,a)/pow(x,a)-1);
+			if(e>emax) emax=e;
+		}
+	}
+	printf("fm_pow max relative error %.3g\n",emax);
+	check_true("fm_pow for x in [1e-300,1e300], a in [0.1,0.5]",emax<TOL);
+	check_true("fm_pow(0,a)==0",fm_pow(0,0.25)==0);
+	check_true("fm_pow(-1,a)==0",fm_pow(-1,0.25)==0);
+	fastmath_sweep();	//the same sweep as <file>_fastmath_check
+
+	TEST_END("test_fastmath");
+}
@@ -0,0 +1,252 @@
+/**************************************************************************
+                 test of udf_of_urban_ventilation_indices.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Ventilation indices on a box mesh with 1 m cells around the DOI
+[0,4]x[0,5]x[0,3], for uniform u=U0, w=W0 and a linear concentration
+Y=CA+CB*z, against the values computed by hand:
+1  vol=60, Ap=74, a_roof=20 (4x5 roof, 2x(5x3)+2x(4x3) sides);
+2  <Y>=CA+1.5CB, PFR=M*vol/(<Y>*RHO), LMAA=<Y>/M, Tau_R=2*LMAA;
+3  VF=1+RHO*U0*5*(3CA+4.5CB)/(vol*M) (inflow through XA only), Q=15*U0,
+   Tau_N=vol/Q, NEV=PFR/Ap;
+4  roof: FAm_out=-RHO*W0*20*(CA+3CB)/M, FAt=-RHO*(MUT/Sct)*CB*20/M, the
+   same for the ZB row of FA_udf, XA/XB rows from U0, no flux across YA/YB;
+5  C_canopy=<Y>, exceedance fractions 1 and 1/3, percentiles within the
+   12.5% bucket width of the exact 1.2e-4;
+6  raster: 1 m cells on 1 m voxels give the cell values exactly;
+7  adapt_mark: the one cell with strain is refined, the rest of the
+   region (up to ZB+ADAPT_BUFFER) coarsened, the top layer left alone.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+#define U0 1.5
+#define W0 0.2
+#define CA 2e-5
+#define CB 4e-5
+#define MUT 0.01
+#define RHO_ 1.29
+#define M_ 1e-5
+#define SCT 0.7
+
+extern real PFR,vol,VF,LMAA,Tau_R,Tau_N,Q,Ap,NEV,FAm_in,FAm_out,FAt,a_roof,C_canopy,U_E;
+extern real FA_in[5],FA_out[5],FA_tur[5],a_side[5],C_p95,C_p99,C_exceed[];
+
+DEFINE_PROFILE(velocity_profile,t,i);
+DEFINE_PROFILE(k_profile,t,i);
+DEFINE_PROFILE(e_profile,t,i);
+DEFINE_SOURCE(Pullation_1,c,t,dS,eqn);
+DEFINE_ON_DEMAND(vol_udf);
+DEFINE_ON_DEMAND(PFR_1_udf);
+DEFINE_ON_DEMAND(LMAA_1_udf);
+DEFINE_ON_DEMAND(Tau_R_1_udf);
+DEFINE_ON_DEMAND(VF_1_udf);
+DEFINE_ON_DEMAND(Q_1_udf);
+DEFINE_ON_DEMAND(Tau_N_1_udf);
+DEFINE_ON_DEMAND(NEV_udf);
+DEFINE_ON_DEMAND(FA_roof_udf);
+DEFINE_ON_DEMAND(yCanopy_udf);
+DEFINE_ON_DEMAND(U_E_udf);
+DEFINE_ON_DEMAND(FA_setup_udf);
+DEFINE_ON_DEMAND(FA_udf);
+DEFINE_ON_DEMAND(raster_setup_udf);
+DEFINE_ON_DEMAND(raster_export_udf);
+DEFINE_ON_DEMAND(indices_fastmath_off);
+DEFINE_ADJUST(adapt_mark,domain);
+
+static real u_of(const real x[3]) {(void)x; return U0;}
+static real w_of(const real x[3]) {(void)x; return W0;}
+static real zero_of(const real x[3]) {(void)x; return 0;}
+static real y_of(const real x[3]) {return CA+CB*x[2];}
+static real mut_of(const real x[3]) {(void)x; return MUT;}
+static real rho_of(const real x[3]) {(void)x; return RHO_;}
+static real strain_of(const real x[3]) {return (x[0]==1.5 && x[1]==2.5 && x[2]==0.5)?1:0;}
+
+static void check_profiles(void)
+{
+	char name[96];
+	Thread *in=mock_side(MOCK_XMIN);
+	face_t f;
+	real x[3];
+
+	indices_fastmath_off();
+	velocity_profile(in,0);
+	k_profile(in,1);
+	e_profile(in,2);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		sprintf(name,"velocity_profile z=%g",x[2]);
+		check_close(name,F_PROFILE(f,in,0),7.84*pow(x[2]/250,0.25),1e-12);
+		sprintf(name,"k_profile z=%g",x[2]);
+		check_close(name,F_PROFILE(f,in,1),0.305272*0.305272/0.3,1e-12);
+		sprintf(name,"e_profile z=%g",x[2]);
+		check_close(name,F_PROFILE(f,in,2),0.305272*0.305272*0.305272/(0.4*x[2]),1e-12);
+	}
+	end_f_loop(f,in)
+}
+
+static void check_source(void)
+{
+	Thread *t=mock_cells();
+	cell_t c;
+	real dS[1],sum=0;
+
+	begin_c_loop(c,t)
+	{
+		sum=sum+Pullation_1(c,t,dS,0)*C_VOLUME(c,t);
+	}
+	end_c_loop(c,t)
+	check_close("Pullation_1 emission",sum,M_*60,1e-12);
+}
+
+static void check_raster(real cpa)
+{
+	//voxel of cell (1.5,2.5,1.5) is column 51, row 52 of 100, counted from the north
+	float v[100*100];
+	FILE *fp;
+	int ok;
+
+	raster_setup_udf();
+	raster_export_udf();
+	fp=fopen("speed_z0.flt","rb");
+	ok=(fp!=NULL && fread(v,sizeof(float),100*100,fp)==100*100);
+	if(fp!=NULL) fclose(fp);
+	check_true("raster speed_z0.flt readable",ok);
+	if(ok)
+	{
+		check_close("raster speed",v[(99-52)*100+51],sqrt(U0*U0+W0*W0),1e-6);
+		check_close("raster no data",v[0],-9999,0);
+	}
+	fp=fopen("concentration_z0.flt","rb");
+	ok=(fp!=NULL && fread(v,sizeof(float),100*100,fp)==100*100);
+	if(fp!=NULL) fclose(fp);
+	check_true("raster concentration_z0.flt readable",ok);
+	if(ok)
+	{
+		check_close("raster concentration",v[(99-52)*100+51],cpa,1e-6);
+	}
+}
+
+static void check_adapt(Domain *d)
+{
+	Thread *t=mock_cells();
+	cell_t c;
+	real x[3];
+	int n_up=0,n_down=0,n_keep=0;
+
+	mock_fill(t,SV_STRAIN_RATE_MAG,strain_of);
+	mock_iter=0;
+	adapt_mark(d);
+	begin_c_loop(c,t)
+	{
+		C_CENTROID(x,c,t);
+		if(C_UDMI(c,t,7)>0)
+		{
+			n_up++;
+			check_true("adapt_mark refines the strain cell",strain_of(x)>0);
+		}
+		else if(C_UDMI(c,t,7)<0)
+		{
+			n_down++;
+		}
+		else
+		{
+			n_keep++;
+		}
+	}
+	end_c_loop(c,t)
+	check_close("adapt_mark refined",n_up,1,0);
+	check_true("adapt_mark coarsens at the ground",C_UDMI(((0*9+0)*6+0),t,7)<0);
+	check_true("adapt_mark reaches z=4.5 over the roof opening",C_UDMI(((0*9+0)*6+4),t,7)<0);
+	check_true("adapt_mark keeps z=5.5",C_UDMI(((0*9+0)*6+5),t,7)==0);
+	check_close("adapt_mark total",n_up+n_down+n_keep,8*9*6,0);
+}
+
+int main(void)
+{
+	const real lo[3]={-2,-2,0},hi[3]={6,7,6};
+	const int n[3]={8,9,6};
+	const int side[6]={THREAD_F_VINLET,THREAD_F_POUTLET,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	Domain *d;
+	Thread *t;
+	real cpa=CA+1.5*CB,out_roof,tur_roof,q_in;
+
+	mock_quiet(1);
+	mock_set_species(1);
+	mock_set_udm(8);
+	d=mock_box(lo,hi,n,side);
+	t=mock_cells();
+	mock_fill(t,SV_U,u_of);
+	mock_fill(t,SV_V,zero_of);
+	mock_fill(t,SV_W,w_of);
+	mock_fill(t,SV_DENSITY,rho_of);
+	mock_fill(t,SV_MU_T,mut_of);
+	mock_fill_species(t,0,y_of);
+	mock_alloc(t,SV_UDM_I);
+
+	check_profiles();
+	check_source();
+
+	//1 geometry
+	vol_udf();
+	check_close("vol",vol,60,1e-12);
+	check_close("Ap",Ap,74,1e-12);
+	check_close("a_roof",a_roof,20,1e-12);
+
+	//2,3 volume and flux indices
+	PFR_1_udf();
+	LMAA_1_udf();
+	Tau_R_1_udf();
+	VF_1_udf();
+	Q_1_udf();
+	Tau_N_1_udf();
+	NEV_udf();
+	q_in=U0*5*(3*CA+4.5*CB);
+	check_close("PFR",PFR,M_*60/(cpa*RHO_),1e-12);
+	check_close("LMAA",LMAA,cpa/M_,1e-12);
+	check_close("Tau_R",Tau_R,2*cpa/M_,1e-12);
+	check_close("VF",VF,1+RHO_*q_in/(60*M_),1e-12);
+	check_close("Q",Q,15*U0,1e-12);
+	check_close("Tau_N",Tau_N,60/(15*U0),1e-12);
+	check_close("NEV",NEV,M_*60/(cpa*RHO_)/74,1e-12);
+
+	//4 roof and all openings
+	out_roof=W0*20*(CA+3*CB);
+	tur_roof=(MUT/SCT)*CB*20;
+	FA_roof_udf();
+	check_close("FAm_in",FAm_in,0,1e-12);
+	check_close("FAm_out",FAm_out,-RHO_*out_roof/M_,1e-12);
+	check_close("FAt",FAt,-RHO_*tur_roof/M_,1e-12);
+	FA_setup_udf();
+	FA_udf();
+	check_close("a_side XA",a_side[0],15,1e-12);
+	check_close("a_side YA",a_side[2],12,1e-12);
+	check_close("a_side ZB",a_side[4],20,1e-12);
+	check_close("FA_in XA",FA_in[0],RHO_*q_in/M_,1e-12);
+	check_close("FA_out XA",FA_out[0],0,1e-12);
+	check_close("FA_out XB",FA_out[1],-RHO_*q_in/M_,1e-12);
+	check_close("FA_in YA",FA_in[2],0,1e-12);
+	check_close("FA_out YB",FA_out[3],0,1e-12);
+	check_close("FA_tur XA",FA_tur[0],0,1e-12);
+	check_close("FA_out ZB",FA_out[4],FAm_out,1e-12);
+	check_close("FA_tur ZB",FA_tur[4],FAt,1e-12);
+
+	//5 concentration statistics
+	yCanopy_udf();
+	U_E_udf();
+	check_close("C_canopy",C_canopy,cpa,1e-12);
+	check_close("C_exceed 1e-5",C_exceed[0],1,1e-12);
+	check_close("C_exceed 1e-4",C_exceed[1],1./3,1e-12);
+	check_close("C_p95",C_p95,1.2e-4,0.125);
+	check_close("C_p99",C_p99,1.2e-4,0.125);
+	check_close("U_E",U_E,(FAm_in-FAm_out+FAt)*M_/(20*cpa),1e-12);
+
+	//6,7
+	check_raster(cpa);
+	check_adapt(d);
+
+	mock_free();
+	TEST_END("test_indices");
+}
@@ -0,0 +1,158 @@
+/**************************************************************************
+                        test of udf_of_inlet.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Inlet profiles and the recycled inflow on a box mesh, against the closed
+forms of the file:
+1  u=UH*(h/DELTA)^A, k=Utau^2/sqrt(Cmu)*(1-h/DELTA), e=Utau^3/(K*h)*(1-h/DELTA),
+   exact with libm (the default) and within 1e-7 with fast math;
+2  velocity_x/z_profile: u*cos and u*sin of udf/wind-dir;
+3  recycle_*_profile from a precursor field u=2+0.01y, k=0.5+0.001y: the
+   plane values rescaled by s=UH*(H/DELTA)^A/u(20), k by s^2, e by s^3;
+   before recycle_update has gathered the plane and without plane cells
+   (solid precursor) the analytic u*cos, k and e of 1,2.
+Mesh: x in [-204,0] (dx 4), y in [0,312] (dy 8), z in [0,40] (dz 10), inlet
+at x=-204, face centroids at y=4,12,...,308.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_PROFILE(velocity_profile,t,i);
+DEFINE_PROFILE(k_profile,t,i);
+DEFINE_PROFILE(e_profile,t,i);
+DEFINE_PROFILE(velocity_x_profile,t,i);
+DEFINE_PROFILE(velocity_z_profile,t,i);
+DEFINE_PROFILE(recycle_u_profile,t,i);
+DEFINE_PROFILE(recycle_k_profile,t,i);
+DEFINE_PROFILE(recycle_e_profile,t,i);
+DEFINE_ON_DEMAND(inlet_fastmath_on);
+DEFINE_ON_DEMAND(inlet_fastmath_off);
+DEFINE_ON_DEMAND(recycle_reset);
+DEFINE_ADJUST(recycle_update,d);
+
+static real u_of(const real x[3]) {return 2+0.01*x[1];}
+static real v_of(const real x[3]) {(void)x; return 0.1;}
+static real k_of(const real x[3]) {return 0.5+0.001*x[1];}
+static real d_of(const real x[3]) {return 0.02+0.0001*x[1];}
+
+static void check_profiles(Thread *in,real tol,const char *tag)
+{
+	char name[96];
+	real x[3],h,u,e;
+	face_t f;
+
+	velocity_profile(in,0);
+	k_profile(in,1);
+	e_profile(in,2);
+	velocity_x_profile(in,3);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		h=x[1];
+		u=(h<=300)?4.8*pow(h/300,0.27):4.8;
+		sprintf(name,"%s velocity_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,0),u,tol);
+		sprintf(name,"%s k_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,1),(h<=300)?0.23*0.23/0.3*(1-h/300):0,tol);
+		e=(h<=300)?0.23*0.23*0.23/(0.435*h)*(1-h/300):0;
+		sprintf(name,"%s e_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,2),e,tol);
+		sprintf(name,"%s velocity_x_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,3),u*cos(M_PI/6),tol);
+	}
+	end_f_loop(f,in)
+	velocity_z_profile(in,3);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		h=x[1];
+		u=(h<=300)?4.8*pow(h/300,0.27):4.8;
+		sprintf(name,"%s velocity_z_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,3),u*sin(M_PI/6),tol);
+	}
+	end_f_loop(f,in)
+}
+
+int main(void)
+{
+	const real lo[3]={-204,0,0},hi[3]={0,312,40};
+	const int n[3]={51,39,4};
+	const int side[6]={THREAD_F_VINLET,THREAD_F_POUTLET,THREAD_F_WALL,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY};
+	char name[96];
+	Domain *d;
+	Thread *in;
+	real x[3],s,h;
+	face_t f;
+
+	mock_quiet(1);
+	d=mock_box(lo,hi,n,side);
+	in=mock_side(MOCK_XMIN);
+	mock_rp_set("udf/wind-dir",30);
+
+	//1,2 analytic profiles: libm by default
+	check_profiles(in,1e-12,"default");
+	inlet_fastmath_off();
+	check_profiles(in,1e-12,"libm");
+	inlet_fastmath_on();
+	check_profiles(in,1e-7,"fast");
+
+	//3 recycled inflow: centroid y=20 is the only one in the sampling band
+	mock_fill(mock_cells(),SV_U,u_of);
+	mock_fill(mock_cells(),SV_V,v_of);
+	mock_fill(mock_cells(),SV_W,v_of);
+	mock_fill(mock_cells(),SV_K,k_of);
+	mock_fill(mock_cells(),SV_D,d_of);
+	recycle_u_profile(in,0);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		h=x[1];
+		s=(h<=300)?4.8*pow(h/300,0.27):4.8;
+		sprintf(name,"recycle_u_profile before recycle_update h=%g",h);
+		check_close(name,F_PROFILE(f,in,0),s*cos(M_PI/6),1e-7);
+	}
+	end_f_loop(f,in)
+	s=4.8*pow(20./300,0.27)/(2+0.01*20);
+	recycle_update(d);
+	recycle_u_profile(in,0);
+	recycle_k_profile(in,1);
+	recycle_e_profile(in,2);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		h=x[1];
+		sprintf(name,"recycle_u_profile h=%g",h);
+		check_close(name,F_PROFILE(f,in,0),s*(2+0.01*h),1e-12);
+		sprintf(name,"recycle_k_profile h=%g",h);
+		check_close(name,F_PROFILE(f,in,1),s*s*(0.5+0.001*h),1e-12);
+		sprintf(name,"recycle_e_profile h=%g",h);
+		check_close(name,F_PROFILE(f,in,2),s*s*s*(0.02+0.0001*h),1e-12);
+	}
+	end_f_loop(f,in)
+
+	//3 no plane cells: analytic profiles
+	mock_cells()->type=THREAD_C_SOLID;
+	recycle_reset();
+	recycle_update(d);
+	recycle_u_profile(in,0);
+	recycle_k_profile(in,1);
+	recycle_e_profile(in,2);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		h=x[1];
+		s=(h<=300)?4.8*pow(h/300,0.27):4.8;
+		sprintf(name,"recycle_u_profile without plane h=%g",h);
+		check_close(name,F_PROFILE(f,in,0),s*cos(M_PI/6),1e-7);
+		sprintf(name,"recycle_k_profile without plane h=%g",h);
+		check_close(name,F_PROFILE(f,in,1),(h<=300)?0.23*0.23/sqrt(0.09)*(1-h/300):0,1e-7);
+		sprintf(name,"recycle_e_profile without plane h=%g",h);
+		check_close(name,F_PROFILE(f,in,2),(h<=300)?0.23*0.23*0.23/(0.435*h)*(1-h/300):0,1e-7);
+	}
+	end_f_loop(f,in)
+	mock_cells()->type=THREAD_C_FLUID;
+
+	mock_free();
+	TEST_END("test_inlet");
+}
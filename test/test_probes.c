@@ -0,0 +1,78 @@
+/**************************************************************************
+                      test of udf_of_probes.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Probes on [0,4]^3 with 1 m cells and u=1+x (no gradients stored, so the
+cell value is sampled):
+1  probes inside the fluid sample the containing cell, a probe outside is
+   kept in the nearest boundary cell;
+2  without fluid cells probe_setup locates nothing and probe_sample reports
+   it instead of reading an empty map.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_ON_DEMAND(probe_setup);
+DEFINE_ON_DEMAND(probe_sample);
+
+static real u_of(const real x[3]) {return 1+x[0];}
+static real one_of(const real x[3]) {(void)x; return 1;}
+
+static int sample_rows(real u[],int n_max)
+{
+	FILE *fp=fopen("probes.dat","r");
+	char line[256];
+	double x,y,z,v[5];
+	int n=0;
+
+	if(fp==NULL) return 0;
+	while(fgets(line,sizeof(line),fp)!=NULL && n<n_max)
+	{
+		if(line[0]=='#') continue;
+		if(sscanf(line,"%lf %lf %lf %lf %lf %lf %lf %lf",&x,&y,&z,&v[0],&v[1],&v[2],&v[3],&v[4])==8) u[n++]=v[0];
+	}
+	fclose(fp);
+	return n;
+}
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={4,4,4};
+	const int n[3]={4,4,4};
+	const int side[6]={THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL};
+	FILE *fp;
+	real u[8];
+
+	mock_quiet(1);
+	mock_set_species(1);
+	mock_box(lo,hi,n,side);
+	mock_fill(mock_cells(),SV_U,u_of);
+	mock_fill(mock_cells(),SV_V,one_of);
+	mock_fill(mock_cells(),SV_W,one_of);
+	mock_fill_species(mock_cells(),0,one_of);
+	fp=fopen("probes.txt","w");
+	fprintf(fp,"0.2 0.2 0.2\n2.7 1.5 3.9\n3.9 0.1 2.5\n9 2 2\n");
+	fclose(fp);
+	remove("probes.dat");
+
+	//1 located probes
+	probe_setup();
+	probe_sample();
+	check_close("probe rows",sample_rows(u,8),4,0);
+	check_close("probe 1 u",u[0],1.5,1e-12);
+	check_close("probe 2 u",u[1],3.5,1e-12);
+	check_close("probe 3 u",u[2],4.5,1e-12);
+	check_close("probe outside u",u[3],4.5,1e-12);
+
+	//2 no fluid cells
+	mock_cells()->type=THREAD_C_SOLID;
+	remove("probes.dat");
+	probe_setup();
+	probe_sample();
+	check_close("probe rows without fluid",sample_rows(u,8),0,0);
+	mock_cells()->type=THREAD_C_FLUID;
+
+	mock_free();
+	TEST_END("test_probes");
+}
@@ -0,0 +1,82 @@
+/**************************************************************************
+                 test of udf_of_ground_roughness.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Ground of [0,10]^2 under a 2 x 2 raster of 5 m pixels, z0 0.3 0.4 (south)
+and 0.1 0.2 (north):
+1  roughness_height gives every ground face Ks=9.793*z0/Cs of its pixel;
+2  after a mesh change (here a finer box whose faces all inherit pixel 0,
+   as adapted faces inherit their parent's) the map is rebuilt instead of
+   returning the stale pixel.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_PROFILE(roughness_height,t,i);
+
+static real z0_at(const real x[3])
+{
+	return (x[1]<5)?((x[0]<5)?0.3:0.4):((x[0]<5)?0.1:0.2);
+}
+
+static Thread *ground(const int n[3])
+{
+	const real lo[3]={0,0,0},hi[3]={10,10,10};
+	const int side[6]={THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	Thread *g;
+
+	mock_box(lo,hi,n,side);
+	g=mock_side(MOCK_ZMIN);
+	mock_alloc(g,SV_UDM_I);
+	mock_alloc_profile(g,1);
+	return g;
+}
+
+static int check_ks(Thread *g)
+{
+	face_t f;
+	real x[3];
+	int ok=1;
+
+	roughness_height(g,0);
+	begin_f_loop(f,g)
+	{
+		F_CENTROID(x,f,g);
+		ok=ok && fabs(F_PROFILE(f,g,0)-9.793*z0_at(x)/0.5)<1e-5;
+	}
+	end_f_loop(f,g)
+	return ok;
+}
+
+int main(void)
+{
+	const int coarse[3]={2,2,2},fine[3]={4,4,2};
+	Thread *g;
+	face_t f;
+	FILE *fp;
+
+	mock_quiet(1);
+	mock_set_udm(1);
+	fp=fopen("roughness.asc","w");
+	fprintf(fp,"ncols 2\nnrows 2\nxllcorner 0\nyllcorner 0\ncellsize 5\nNODATA_value -9999\n0.1 0.2\n0.3 0.4\n");
+	fclose(fp);
+
+	//1 first mapping
+	g=ground(coarse);
+	check_true("roughness_height on the first mesh",check_ks(g));
+	check_true("roughness_height from the cached pixels",check_ks(g));
+	mock_free();
+
+	//2 changed mesh with stale pixels
+	g=ground(fine);
+	begin_f_loop(f,g)
+	{
+		F_UDMI(f,g,0)=1;
+	}
+	end_f_loop(f,g)
+	check_true("roughness_height after a mesh change",check_ks(g));
+	mock_free();
+
+	TEST_END("test_roughness");
+}
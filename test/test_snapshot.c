@@ -0,0 +1,253 @@
+/**************************************************************************
+                      test of the snapshot reader
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+export_snapshot_udf of udf_of_urban_ventilation_indices.c on a box mesh,
+read back with umc_snap_open of umc_snapshot.h:
+1  counts, cell values and face neighbours of the exported snapshot;
+2  damaged copies are rejected: truncated file, bad header size, misaligned
+   or out-of-file array offset, face neighbour beyond n_cells, bad magic;
+   a snapshot without species (n_species 0) is accepted;
+3  the snapshot split into two partitions (x<2 and x>2, with ghost cells, as
+   a parallel export writes them) is refused by umc_snap_open and joined by
+   umc_snap_merge into the same cells and faces.
+**************************************************************************/
+
+#define UMC_SNAPSHOT_READER
+#include "mock_mesh.h"
+#include "umc_snapshot.h"
+#include "test_util.h"
+
+DEFINE_ON_DEMAND(export_snapshot_udf);
+
+static real u_of(const real x[3]) {return 1+x[0];}
+static real one_of(const real x[3]) {(void)x; return 1;}
+static real y_of(const real x[3]) {return 1e-5*(1+x[2]);}
+
+static char *file_read(const char *path,size_t *len)
+{
+	FILE *fp=fopen(path,"rb");
+	char *b;
+
+	if(fp==NULL) return NULL;
+	fseek(fp,0,SEEK_END);
+	*len=ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	b=(char *)malloc(*len);
+	if(fread(b,1,*len,fp)!=*len)
+	{
+		free(b);
+		b=NULL;
+	}
+	fclose(fp);
+	return b;
+}
+
+static void file_write(const char *path,const char *b,size_t len)
+{
+	FILE *fp=fopen(path,"wb");
+	fwrite(b,1,len,fp);
+	fclose(fp);
+}
+
+static void check_rejected(const char *name,const char *b,size_t len)
+{
+	umc_snapshot s;
+	char err[128];
+	int r;
+
+	file_write("damaged.umc",b,len);
+	r=umc_snap_open("damaged.umc",&s,err,sizeof(err));
+	check_true(name,r!=0);
+	if(r==0) umc_snap_close(&s);
+}
+
+static int part_of(const umc_snapshot *s,int64_t c) {return s->cx[c]>2;}
+
+static void write_part(const umc_snapshot *s,int part,const char *path)
+{
+	//owned cells in snapshot order, then the ghosts, faces of the c0 owner
+	umc_snap_header h=*s->h;
+	uint64_t nc=s->h->n_cells,nf=s->h->n_faces,c,f,sp,n=0,n_own,m=0,k;
+	int64_t *loc=(int64_t *)malloc(nc*sizeof(int64_t)),*cell=(int64_t *)malloc(nc*sizeof(int64_t));
+	FILE *fp=fopen(path,"wb");
+	double *v=(double *)malloc((nc+nf)*sizeof(double));
+	const double *a;
+
+	for(c=0;c<nc;c++)
+	{
+		loc[c]=-1;
+		if(part_of(s,c)==part) {loc[c]=n; cell[n++]=c;}
+	}
+	n_own=n;
+	for(f=0;f<nf;f++)
+	{
+		if(part_of(s,s->fc0[f])!=part) continue;
+		m++;
+		if(s->fc1[f]>=0 && loc[s->fc1[f]]<0) {loc[s->fc1[f]]=n; cell[n++]=s->fc1[f];}
+	}
+	h.flags|=UMC_FLAG_PART;
+	h.n_cells=n;
+	h.n_faces=m;
+	h.n_ghost=n-n_own;
+	h.part=part;
+	h.n_parts=2;
+	h.offset[0]=UMC_ALIGN_UP(sizeof(h));
+	for(k=1;k<UMC_N_ARRAYS;k++)
+	{
+		h.offset[k]=h.offset[k-1]+UMC_ALIGN_UP(((k-1==UMC_YI)?n*h.n_species:(k-1<UMC_YI)?n:m)*8);
+	}
+	fwrite(&h,sizeof(h),1,fp);
+	for(k=0;k<UMC_N_ARRAYS;k++)
+	{
+		fseek(fp,h.offset[k],SEEK_SET);
+		a=(const double *)((const char *)s->map+s->h->offset[k]);
+		for(sp=0;sp<((k==UMC_YI)?h.n_species:1);sp++)
+		{
+			for(c=0,m=0;k<=UMC_YI && c<n;c++) v[m++]=a[sp*nc+cell[c]];
+			for(f=0;k>UMC_YI && f<nf;f++)
+			{
+				if(part_of(s,s->fc0[f])!=part) continue;
+				if(k==UMC_FC0) ((int64_t *)v)[m++]=loc[s->fc0[f]];
+				else if(k==UMC_FC1) ((int64_t *)v)[m++]=(s->fc1[f]<0)?-1:loc[s->fc1[f]];
+				else v[m++]=a[f];
+			}
+			fwrite(v,8,m,fp);
+		}
+	}
+	fclose(fp);
+	free(loc);
+	free(cell);
+	free(v);
+}
+
+static void check_merge(void)
+{
+	umc_snapshot s,p,r;
+	char err[256],*parts[2]={"part.p1","part.p0"};
+	uint64_t f,g;
+	int ok=1,found;
+
+	if(umc_snap_open("snapshot.umc",&s,err,sizeof(err))!=0) return;
+	write_part(&s,0,"part.p0");
+	write_part(&s,1,"part.p1");
+	check_true("umc_snap_open refuses a partition",umc_snap_open("part.p0",&p,err,sizeof(err))!=0);
+	check_true("umc_snap_merge needs every partition",umc_snap_merge("merged.umc",parts+1,1,err,sizeof(err))!=0);
+	check_true("umc_snap_merge",umc_snap_merge("merged.umc",parts,2,err,sizeof(err))==0);
+	if(umc_snap_open("merged.umc",&r,err,sizeof(err))!=0)
+	{
+		printf("merged.umc: %s\n",err);
+		check_true("merged.umc readable",0);
+		umc_snap_close(&s);
+		return;
+	}
+	check_close("merged n_cells",r.h->n_cells,s.h->n_cells,0);
+	check_close("merged n_faces",r.h->n_faces,s.h->n_faces,0);
+	check_true("merged is not a partition",!(r.h->flags&UMC_FLAG_PART) && r.h->n_ghost==0);
+	for(f=0;f<r.h->n_faces;f++)
+	{
+		//the same face (by centroid) joins the same cells (by centroid and value)
+		found=0;
+		for(g=0;g<s.h->n_faces && !found;g++)
+		{
+			if(r.fx[f]!=s.fx[g] || r.fy[f]!=s.fy[g] || r.fz[f]!=s.fz[g]) continue;
+			found=1;
+			ok=ok && r.cx[r.fc0[f]]==s.cx[s.fc0[g]] && r.cy[r.fc0[f]]==s.cy[s.fc0[g]] && r.cz[r.fc0[f]]==s.cz[s.fc0[g]] && r.u[r.fc0[f]]==s.u[s.fc0[g]];
+			ok=ok && (r.fc1[f]<0)==(s.fc1[g]<0);
+			ok=ok && (s.fc1[g]<0 || (r.cx[r.fc1[f]]==s.cx[s.fc1[g]] && r.cy[r.fc1[f]]==s.cy[s.fc1[g]] && r.cz[r.fc1[f]]==s.cz[s.fc1[g]] && r.yi[r.fc1[f]]==s.yi[s.fc1[g]]));
+			ok=ok && r.fax[f]==s.fax[g];
+		}
+		ok=ok && found;
+	}
+	check_true("merged faces join the same cells",ok);
+	umc_snap_close(&r);
+	umc_snap_close(&s);
+}
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={4,3,2};
+	const int n[3]={4,3,2};
+	const int side[6]={THREAD_F_VINLET,THREAD_F_POUTLET,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	umc_snapshot s;
+	umc_snap_header *h;
+	char err[128],*b,*d;
+	size_t len;
+	uint64_t c,f,n_bnd=0;
+	int ok=1;
+
+	mock_quiet(1);
+	mock_set_species(1);
+	mock_box(lo,hi,n,side);
+	mock_fill(mock_cells(),SV_U,u_of);
+	mock_fill(mock_cells(),SV_V,one_of);
+	mock_fill(mock_cells(),SV_W,one_of);
+	mock_fill(mock_cells(),SV_MU_T,one_of);
+	mock_fill(mock_cells(),SV_DENSITY,one_of);
+	mock_fill_species(mock_cells(),0,y_of);
+	export_snapshot_udf();
+
+	//1 round trip
+	check_true("umc_snap_open snapshot.umc",umc_snap_open("snapshot.umc",&s,err,sizeof(err))==0);
+	if(s.h==NULL)
+	{
+		printf("reader: %s\n",err);
+		TEST_END("test_snapshot");
+	}
+	check_close("n_cells",s.h->n_cells,24,0);
+	check_close("n_faces",s.h->n_faces,3*3*2+4*2*2+4*3*1+2*(3*2+4*2+4*3),0);
+	check_close("n_species",s.h->n_species,1,0);
+	for(c=0;c<s.h->n_cells;c++)
+	{
+		ok=ok && s.u[c]==1+s.cx[c] && s.vol[c]==1 && s.yi[c]==1e-5*(1+s.cz[c]);
+	}
+	check_true("cell values",ok);
+	for(f=0;f<s.h->n_faces;f++)
+	{
+		n_bnd+=(s.fc1[f]<0);
+	}
+	check_close("boundary faces",n_bnd,2*(3*2+4*2+4*3),0);
+	umc_snap_close(&s);
+
+	//2 damaged copies
+	b=file_read("snapshot.umc",&len);
+	check_true("snapshot.umc readable",b!=NULL);
+	if(b!=NULL)
+	{
+		d=(char *)malloc(len);
+		h=(umc_snap_header *)d;
+		check_rejected("truncated",b,len-64);
+		check_rejected("header only",b,sizeof(umc_snap_header));
+		memcpy(d,b,len); h->header_size=8;
+		check_rejected("header_size too small",d,len);
+		memcpy(d,b,len); h->header_size=(uint32_t)len+1;
+		check_rejected("header_size beyond the file",d,len);
+		memcpy(d,b,len); h->offset[UMC_U]+=8;
+		check_rejected("misaligned offset",d,len);
+		memcpy(d,b,len); h->offset[UMC_FZ]=UMC_ALIGN_UP(len);
+		check_rejected("offset beyond the file",d,len);
+		memcpy(d,b,len); h->n_cells=len;
+		check_rejected("n_cells beyond the file",d,len);
+		memcpy(d,b,len); h->n_species=0x7fffffff;
+		check_rejected("n_species beyond the file",d,len);
+		memcpy(d,b,len); ((int64_t *)(d+h->offset[UMC_FC0]))[3]=24;
+		check_rejected("fc0 beyond n_cells",d,len);
+		memcpy(d,b,len); ((int64_t *)(d+h->offset[UMC_FC1]))[0]=-2;
+		check_rejected("fc1 below -1",d,len);
+		memcpy(d,b,len); d[0]='X';
+		check_rejected("bad magic",d,len);
+		memcpy(d,b,len); h->n_species=0;
+		file_write("nospecies.umc",d,len);
+		ok=(umc_snap_open("nospecies.umc",&s,err,sizeof(err))==0);
+		check_true("n_species 0 readable",ok && s.yi==NULL);
+		if(ok) umc_snap_close(&s);
+		free(d);
+		free(b);
+	}
+
+	//3 partitions
+	check_merge();
+
+	mock_free();
+	TEST_END("test_snapshot");
+}
@@ -0,0 +1,98 @@
+/**************************************************************************
+                  test of udf_of_solar_radiation.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Open ground: a 10 m box whose only wall is the ground (4x4 faces), the
+other sides are symmetry planes:
+1  svf_compute gives SVF=1 on every ground face and stores it in UDM_SVF;
+2  solar_heat_flux at flow time 0 (solar hour 6) is ABS_SW*(DNI*cos i+DHI*SVF);
+3  after solar_reset (as after reading a case/data file) the SVF is taken
+   back from the face UDM on first use, and a UDM of zeros (no svf_compute
+   yet) falls back to the isotropic sky.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+#define UDM_SVF 1
+
+DEFINE_PROFILE(solar_heat_flux,t,i);
+DEFINE_ON_DEMAND(svf_compute);
+DEFINE_ON_DEMAND(solar_reset);
+
+static double sun_up(double hour)
+{
+	//vertical component of the sun vector, as sun_vector of the UDF
+	double phi=31.23*M_PI/180.;
+	double dec=23.45*M_PI/180.*sin(2*M_PI*(284+196)/365.);
+	double w=(hour-12.)*15.*M_PI/180.;
+	return sin(phi)*sin(dec)+cos(phi)*cos(dec)*cos(w);
+}
+
+static void check_flux(const char *name,double sky)
+{
+	Thread *g=mock_side(MOCK_ZMIN);
+	face_t f;
+	int ok=1;
+
+	solar_heat_flux(g,0);
+	begin_f_loop(f,g)
+	{
+		ok=ok && fabs(F_PROFILE(f,g,0)-0.7*(800*sun_up(6.5)+100*sky))<1e-9;
+	}
+	end_f_loop(f,g)
+	check_true(name,ok);
+}
+
+static void set_udm(double v)
+{
+	Thread *g=mock_side(MOCK_ZMIN);
+	face_t f;
+
+	begin_f_loop(f,g)
+	{
+		F_UDMI(f,g,UDM_SVF)=v;
+	}
+	end_f_loop(f,g)
+}
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={10,10,10};
+	const int n[3]={4,4,4};
+	const int side[6]={THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_WALL,THREAD_F_SYMMETRY};
+	Thread *g;
+	face_t f;
+	int ok=1;
+
+	mock_quiet(1);
+	mock_set_udm(2);
+	mock_box(lo,hi,n,side);
+	g=mock_side(MOCK_ZMIN);
+	mock_alloc(g,SV_UDM_I);
+	mock_time=0;
+	check_true("sun is up at 6:30",sun_up(6.5)>0);
+
+	//1 SVF of open ground
+	svf_compute();
+	begin_f_loop(f,g)
+	{
+		ok=ok && F_UDMI(f,g,UDM_SVF)==1;
+	}
+	end_f_loop(f,g)
+	check_true("svf_compute: SVF=1 on open ground",ok);
+
+	//2 flux with the computed SVF
+	check_flux("solar_heat_flux with the SVF",1);
+
+	//3 restart: SVF from the face UDM, or the isotropic sky without one
+	solar_reset();
+	set_udm(0.25);
+	check_flux("solar_heat_flux with the SVF read back from UDM",0.25);
+	solar_reset();
+	set_udm(0);
+	check_flux("solar_heat_flux without a stored SVF",0.5*(1+1));
+
+	mock_free();
+	TEST_END("test_solar");
+}
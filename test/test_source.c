@@ -0,0 +1,44 @@
+/**************************************************************************
+                 test of udf_of_source_particular_area.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Box source on [0,3]^3 with 0.5 m cells: the 8 cells with centroids in
+(1,2)^3 get 1, all others 0, and dS is 0 everywhere.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_SOURCE(udf_source,c,t,dS,eqn);
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={3,3,3};
+	const int n[3]={6,6,6};
+	const int side[6]={THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL,THREAD_F_WALL};
+	char name[96];
+	Thread *t;
+	cell_t c;
+	real x[3],dS[1],s,sum=0;
+	int inside;
+
+	mock_quiet(1);
+	mock_box(lo,hi,n,side);
+	t=mock_cells();
+	begin_c_loop(c,t)
+	{
+		C_CENTROID(x,c,t);
+		inside=x[0]>1 && x[0]<2 && x[1]>1 && x[1]<2 && x[2]>1 && x[2]<2;
+		dS[0]=-1;
+		s=udf_source(c,t,dS,0);
+		sprintf(name,"udf_source (%g,%g,%g)",x[0],x[1],x[2]);
+		check_close(name,s,inside?1:0,0);
+		check_close(name,dS[0],0,0);
+		sum=sum+s;
+	}
+	end_c_loop(c,t)
+	check_close("udf_source cells",sum,8,0);
+
+	mock_free();
+	TEST_END("test_source");
+}
@@ -0,0 +1,128 @@
+/**************************************************************************
+                         test of udf_of_tree.c
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Tree sources and inlet profiles on a box mesh, against the closed forms:
+1  leaf area density lad(y)=Lm*r^6*exp(6(1-r)) below Zm and
+   Lm*sqrt(r)*exp(0.5(1-r)) from Zm to H, r=(H-Zm)/(H-y), 0 above H;
+2  momentum sources -Cdf*lad*|U|*u_i, k source Cdf*lad*|U|^3-4Cdf*lad*|U|*k,
+   e source 1.5Cdf*lad*|U|^3-6Cdf*lad*|U|*e, and their derivatives;
+3  inlet u=6*(h/10)^(1/6), k and e of the flat-plate boundary layer.
+Exact with libm, within 1e-7 with fast math.
+**************************************************************************/
+
+#include "mock_mesh.h"
+#include "test_util.h"
+
+DEFINE_SOURCE(x_momentum_source,c,t,dS,eqn);
+DEFINE_SOURCE(y_momentum_source,c,t,dS,eqn);
+DEFINE_SOURCE(z_momentum_source,c,t,dS,eqn);
+DEFINE_SOURCE(k_source,c,t,dS,eqn);
+DEFINE_SOURCE(e_source,c,t,dS,eqn);
+DEFINE_PROFILE(velocity_profile,t,i);
+DEFINE_PROFILE(k_profile,t,i);
+DEFINE_PROFILE(e_profile,t,i);
+DEFINE_ON_DEMAND(tree_fastmath_on);
+DEFINE_ON_DEMAND(tree_fastmath_off);
+
+static real u_of(const real x[3]) {return 1+x[1];}
+static real v_of(const real x[3]) {(void)x; return 0.1;}
+static real w_of(const real x[3]) {(void)x; return -0.2;}
+static real k_of(const real x[3]) {(void)x; return 0.3;}
+static real d_of(const real x[3]) {(void)x; return 0.05;}
+
+static double lad_ref(double y)
+{
+	double r=(1.0-0.6)/(1.0-y);
+	if(y>=0 && y<0.6) return 36.01*pow(r,6)*exp(6*(1-r));
+	if(y>=0.6 && y<1.0) return 36.01*sqrt(r)*exp(0.5*(1-r));
+	return 0;
+}
+
+static void check_sources(real tol,const char *tag)
+{
+	char name[96];
+	Thread *t=mock_cells();
+	cell_t c;
+	real x[3],dS[1],lad,w,u,v,ww;
+
+	begin_c_loop(c,t)
+	{
+		C_CENTROID(x,c,t);
+		u=1+x[1];
+		v=0.1;
+		ww=-0.2;
+		w=sqrt(u*u+v*v+ww*ww);
+		lad=lad_ref(x[1]);
+		sprintf(name,"%s x_momentum_source y=%g",tag,x[1]);
+		check_close(name,x_momentum_source(c,t,dS,0),-0.2*lad*w*u,tol);
+		check_close(name,dS[0],-0.2*lad*w,tol);
+		sprintf(name,"%s y_momentum_source y=%g",tag,x[1]);
+		check_close(name,y_momentum_source(c,t,dS,0),-0.2*lad*w*v,tol);
+		sprintf(name,"%s z_momentum_source y=%g",tag,x[1]);
+		check_close(name,z_momentum_source(c,t,dS,0),-0.2*lad*w*ww,tol);
+		sprintf(name,"%s k_source y=%g",tag,x[1]);
+		check_close(name,k_source(c,t,dS,0),0.2*lad*w*w*w-4*0.2*lad*w*0.3,tol);
+		check_close(name,dS[0],-4*0.2*lad*w,tol);
+		sprintf(name,"%s e_source y=%g",tag,x[1]);
+		check_close(name,e_source(c,t,dS,0),1.5*0.2*lad*w*w*w-6*0.2*lad*w*0.05,tol);
+		check_close(name,dS[0],-6*0.2*lad*w,tol);
+	}
+	end_c_loop(c,t)
+}
+
+static void check_profiles(real tol,const char *tag)
+{
+	char name[96];
+	Thread *in=mock_side(MOCK_XMIN);
+	face_t f;
+	real x[3],h,utau;
+
+	utau=sqrt(0.074/pow(6*25/1.5e-5,0.2)*6*6*0.5);
+	velocity_profile(in,0);
+	k_profile(in,1);
+	e_profile(in,2);
+	begin_f_loop(f,in)
+	{
+		F_CENTROID(x,f,in);
+		h=x[1];
+		sprintf(name,"%s velocity_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,0),(h<=10)?6*pow(h/10,1./6):6,tol);
+		sprintf(name,"%s k_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,1),(h<=5)?utau*utau*(1-h/5)*(1-h/5)/0.3:0,tol);
+		sprintf(name,"%s e_profile h=%g",tag,h);
+		check_close(name,F_PROFILE(f,in,2),(h<=5)?utau*utau*utau*(1-h/5)*(1-h/5)/(0.435*(h+0.0025))*(1+5.75*h/0.0025):0,tol);
+	}
+	end_f_loop(f,in)
+}
+
+int main(void)
+{
+	const real lo[3]={0,0,0},hi[3]={1,1.2,1},hi_p[3]={1,12,1};
+	const int n[3]={2,12,2},n_p[3]={1,12,1};
+	const int side[6]={THREAD_F_VINLET,THREAD_F_POUTLET,THREAD_F_WALL,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY,THREAD_F_SYMMETRY};
+
+	mock_quiet(1);
+
+	//1,2 sources through the crown (centroids y=0.05..1.15 cross Zm and H)
+	mock_box(lo,hi,n,side);
+	mock_fill(mock_cells(),SV_U,u_of);
+	mock_fill(mock_cells(),SV_V,v_of);
+	mock_fill(mock_cells(),SV_W,w_of);
+	mock_fill(mock_cells(),SV_K,k_of);
+	mock_fill(mock_cells(),SV_D,d_of);
+	tree_fastmath_off();
+	check_sources(1e-12,"libm");
+	tree_fastmath_on();
+	check_sources(1e-7,"fast");
+
+	//3 profiles up to y=12, above WW and del
+	mock_box(lo,hi_p,n_p,side);
+	tree_fastmath_off();
+	check_profiles(1e-12,"libm");
+	tree_fastmath_on();
+	check_profiles(1e-7,"fast");
+
+	mock_free();
+	TEST_END("test_tree");
+}
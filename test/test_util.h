@@ -0,0 +1,49 @@
+/**************************************************************************
+                              test helpers
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Checks shared by the closed-form tests: every failed check is reported
+with its name, the value obtained and the value expected, and the test
+program exits non-zero if any check failed (TEST_END).
+**************************************************************************/
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <math.h>
+
+static int test_fails=0;
+static int test_checks=0;
+
+static void check_close(const char *name,double got,double want,double rtol)
+{
+	//relative tolerance, absolute for an expected zero
+	double scale=(want!=0)?fabs(want):1;
+
+	test_checks++;
+	if(!(fabs(got-want)<=rtol*scale))
+	{
+		printf("FAIL %s: got %.12g, expected %.12g (rtol %g)\n",name,got,want,rtol);
+		test_fails++;
+	}
+}
+
+static void check_true(const char *name,int ok)
+{
+	test_checks++;
+	if(!ok)
+	{
+		printf("FAIL %s\n",name);
+		test_fails++;
+	}
+}
+
+#define TEST_END(name) \
+	do \
+	{ \
+		printf("%s: %d checks, %d failed\n",name,test_checks,test_fails); \
+		return test_fails?1:0; \
+	} while(0)
+
+#endif
@@ -0,0 +1,113 @@
+/**************************************************************************
+                          hot-path counters
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Optional instrumentation of the DEFINE_PROFILE, DEFINE_SOURCE and
+DEFINE_ON_DEMAND functions: call count, entities (faces or cells)
+processed and elapsed ticks (TSC cycles on x86, nanoseconds elsewhere).
+Counters live in each compiled library and each Fluent process, so every
+partition keeps and reports its own numbers.
+Compile with UDF_COUNTERS defined (e.g. add -DUDF_COUNTERS to the UDF
+makefile CFLAGS) to enable; otherwise all macros expand to nothing.
+Each UDF file lists its counters with UDF_COUNTERS_TABLE and provides
+report/reset DEFINE_ON_DEMAND functions around UDF_COUNTERS_REPORT and
+UDF_COUNTERS_RESET.
+**************************************************************************/
+
+#ifndef UDF_COUNTERS_H
+#define UDF_COUNTERS_H
+
+#ifdef UDF_COUNTERS
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define udf_ticks() ((unsigned long long)__rdtsc())
+#define UDF_TICK_UNIT "cycles"
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define udf_ticks() ((unsigned long long)__rdtsc())
+#define UDF_TICK_UNIT "cycles"
+#else
+#include <time.h>
+static unsigned long long udf_ticks(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+#define UDF_TICK_UNIT "ns"
+#endif
+
+typedef struct
+{
+	const char *name;
+	unsigned long long calls;
+	unsigned long long entities;
+	unsigned long long ticks;
+} udf_counter;
+
+#define UDF_COUNTERS_TABLE static udf_counter udf_counters[]=
+#define UDF_COUNTER_BEGIN unsigned long long udf_t0_=udf_ticks()
+#define UDF_COUNTER_END(id,n) \
+	(udf_counters[id].calls++, \
+	 udf_counters[id].entities+=(unsigned long long)(n), \
+	 udf_counters[id].ticks+=udf_ticks()-udf_t0_)
+
+static int udf_domain_cells(Domain *d)
+{
+	Thread *t;
+	int n=0;
+	thread_loop_c(t,d)
+	{
+		n+=THREAD_N_ELEMENTS_INT(t);
+	}
+	return n;
+}
+
+static int udf_domain_faces(Domain *d)
+{
+	Thread *t;
+	int n=0;
+	thread_loop_f(t,d)
+	{
+		n+=THREAD_N_ELEMENTS_INT(t);
+	}
+	return n;
+}
+
+#define UDF_COUNTERS_REPORT(fname) \
+	{ \
+		int udf_i_; \
+		FILE *udf_fp_=fopen(fname,"a"); \
+		for(udf_i_=0;udf_i_<(int)(sizeof(udf_counters)/sizeof(udf_counters[0]));udf_i_++) \
+		{ \
+			udf_counter *udf_c_=&udf_counters[udf_i_]; \
+			if(udf_c_->calls==0) continue; \
+			Message("%-28s calls %12llu entities %14llu %s %16llu (%.1f/entity)\n",udf_c_->name, \
+				udf_c_->calls,udf_c_->entities,UDF_TICK_UNIT,udf_c_->ticks, \
+				udf_c_->entities?(double)udf_c_->ticks/udf_c_->entities:0.0); \
+			if(udf_fp_!=NULL) fprintf(udf_fp_,"%s %llu %llu %llu %s\n",udf_c_->name, \
+				udf_c_->calls,udf_c_->entities,udf_c_->ticks,UDF_TICK_UNIT); \
+		} \
+		if(udf_fp_!=NULL) fclose(udf_fp_); \
+	}
+
+#define UDF_COUNTERS_RESET() \
+	{ \
+		int udf_i_; \
+		for(udf_i_=0;udf_i_<(int)(sizeof(udf_counters)/sizeof(udf_counters[0]));udf_i_++) \
+		{ \
+			udf_counters[udf_i_].calls=0; \
+			udf_counters[udf_i_].entities=0; \
+			udf_counters[udf_i_].ticks=0; \
+		} \
+	}
+
+#else
+
+#define UDF_COUNTER_BEGIN
+#define UDF_COUNTER_END(id,n)
+
+#endif
+
+#endif
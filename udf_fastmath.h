@@ -0,0 +1,93 @@
+/**************************************************************************
+                              fast math
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Polynomial replacements of exp() and pow() for the inlet profiles and the
+leaf area density:
+1  fm_exp(x): 2^k*p(r) with |r|<=ln2/2 and a degree-7 Taylor polynomial;
+   0 for x<-708 (where libm gives subnormals) and +inf from the overflow
+   threshold 709.78 on, as libm;
+2  fm_log(x): exponent/mantissa split with the mantissa in [sqrt(.5),sqrt(2))
+   and the atanh series up to s^9, valid for normal x>0;
+3  fm_pow(x,a)=fm_exp(a*fm_log(x)) for x>0, 0 for x<=0.
+Maximum relative error against libm (sweep in fastmath_check and
+test/test_fastmath.c): fm_exp 7.0e-9 on [-708,709.7], fm_pow 7.3e-9 for
+x in [1e-300,1e300] and a in [0.1,0.5], i.e. below the resolution of
+single-precision real. UDF_FAST_EXP/UDF_FAST_POW switch between these and libm at
+run time through udf_fast_math (<file>_fastmath_on/_off/_check on demand).
+Off by default: the profiles give the libm results until <file>_fastmath_on
+is run.
+**************************************************************************/
+
+#ifndef UDF_FASTMATH_H
+#define UDF_FASTMATH_H
+
+#include <math.h>
+#include <stdint.h>
+
+static int udf_fast_math=0;  //0: exact libm (default), 1: fm_exp/fm_pow
+
+static double fm_exp(double x)
+{
+	union {double d; int64_t i;} s;
+	double k,r,p,xc;
+
+	xc=(x<-708.)?-708.:((x>710.)?710.:x);    //keeps k inside [-1021,1024]
+	k=(xc*1.4426950408889634+6755399441055744.)-6755399441055744.;  //x/ln2 rounded to nearest
+	r=xc-k*0.6931471805599453;
+	p=1+r*(1+r*(1./2+r*(1./6+r*(1./24+r*(1./120+r*(1./720+r*(1./5040)))))));
+	s.i=((int64_t)k+1022)<<52;              //2^(k-1): k=1024 still has an exponent
+	return (x<-708.)?0:(2*p)*s.d;           //overflows to +inf past 709.78
+}
+
+static double fm_log(double x)
+{
+	union {double d; int64_t i;} m;
+	double e,s,s2;
+	int big;
+
+	m.d=x;
+	e=(double)(((m.i>>52)&0x7ff)-1023);
+	m.i=(m.i&0x000fffffffffffffLL)|0x3ff0000000000000LL;   //mantissa in [1,2)
+	big=(m.d>1.4142135623730951);           //select, not branch
+	m.d=big?0.5*m.d:m.d;
+	e=e+big;
+	s=(m.d-1)/(m.d+1);
+	s2=s*s;
+	return e*0.6931471805599453+2*s*(1+s2*(1./3+s2*(1./5+s2*(1./7+s2*(1./9)))));
+}
+
+static double fm_pow(double x,double a)
+{
+	return (x>0)?fm_exp(a*fm_log(x)):0;
+}
+
+#define UDF_FAST_EXP(x) (udf_fast_math?fm_exp(x):exp(x))
+#define UDF_FAST_POW(x,a) (udf_fast_math?fm_pow(x,a):pow(x,a))
+
+static void fastmath_sweep(void)
+{
+	//maximum relative error against libm over the ranges used by the UDFs
+	double x,a,e,emax_exp=0,emax_pow=0;
+	int i,j;
+
+	for(i=0;i<=400000;i++)
+	{
+		x=-708+1417.7*i/400000.;
+		e=fabs(fm_exp(x)/exp(x)-1);
+		if(e>emax_exp) emax_exp=e;
+	}
+	for(j=0;j<=40;j++)
+	{
+		a=0.1+0.01*j;
+		for(i=0;i<=100000;i++)
+		{
+			x=pow(10,-300+600*i/100000.);
+			e=fabs(fm_pow(x,a)/pow(x,a)-1);
+			if(e>emax_pow) emax_pow=e;
+		}
+	}
+	Message("fast math: max relative error exp %.3g, pow %.3g (fast math %s)\n",emax_exp,emax_pow,udf_fast_math?"on":"off");
+}
+
+#endif
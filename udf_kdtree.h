@@ -0,0 +1,151 @@
+/**************************************************************************
+                          k-d tree of points
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Static balanced k-d tree over a set of 3D points (e.g. cell centroids),
+stored implicitly: the node of index range [lo,hi) is idx[(lo+hi)/2], split
+along axis[(lo+hi)/2]. Built once in O(n log n), nearest-neighbour queries
+in O(log n) on average. The coordinates stay owned by the caller.
+**************************************************************************/
+
+#ifndef UDF_KDTREE_H
+#define UDF_KDTREE_H
+
+typedef struct
+{
+	int n;
+	const real *x;           //3*n coordinates
+	int *idx;                //point permutation forming the tree
+	unsigned char *axis;     //split axis of every node
+} udf_kdtree;
+
+static void kd_select(udf_kdtree *kd,int lo,int hi,int k,int ax)
+{
+	//quickselect: idx[k] becomes the k-th point along ax within [lo,hi)
+	int i,j,tmp;
+	real pivot;
+
+	while(hi-lo>1)
+	{
+		pivot=kd->x[3*kd->idx[(lo+hi)/2]+ax];
+		i=lo;
+		j=hi-1;
+		while(i<=j)
+		{
+			while(kd->x[3*kd->idx[i]+ax]<pivot) i++;
+			while(kd->x[3*kd->idx[j]+ax]>pivot) j--;
+			if(i<=j)
+			{
+				tmp=kd->idx[i]; kd->idx[i]=kd->idx[j]; kd->idx[j]=tmp;
+				i++;
+				j--;
+			}
+		}
+		if(k<=j) hi=j+1;
+		else if(k>=i) lo=i;
+		else return;
+	}
+}
+
+static void kd_build_range(udf_kdtree *kd,int lo,int hi)
+{
+	real lo_x[3],hi_x[3];
+	int i,d,ax,mid;
+
+	if(hi-lo<=1)
+	{
+		if(hi-lo==1) kd->axis[lo]=0;
+		return;
+	}
+	for(d=0;d<3;d++)
+	{
+		lo_x[d]=hi_x[d]=kd->x[3*kd->idx[lo]+d];
+	}
+	for(i=lo+1;i<hi;i++)
+	{
+		for(d=0;d<3;d++)
+		{
+			real v=kd->x[3*kd->idx[i]+d];
+			if(v<lo_x[d]) lo_x[d]=v;
+			if(v>hi_x[d]) hi_x[d]=v;
+		}
+	}
+	ax=0;
+	for(d=1;d<3;d++)
+	{
+		if(hi_x[d]-lo_x[d]>hi_x[ax]-lo_x[ax]) ax=d;
+	}
+	mid=(lo+hi)/2;
+	kd_select(kd,lo,hi,mid,ax);
+	kd->axis[mid]=(unsigned char)ax;
+	kd_build_range(kd,lo,mid);
+	kd_build_range(kd,mid+1,hi);
+}
+
+static void kd_build(udf_kdtree *kd,const real *x,int n)
+{
+	int i;
+
+	kd->n=n;
+	kd->x=x;
+	kd->idx=(int *)malloc((n>0?n:1)*sizeof(int));
+	kd->axis=(unsigned char *)malloc(n>0?n:1);
+	for(i=0;i<n;i++)
+	{
+		kd->idx[i]=i;
+	}
+	kd_build_range(kd,0,n);
+}
+
+static void kd_nearest_range(const udf_kdtree *kd,int lo,int hi,const real p[3],int *best,real *best_d2)
+{
+	int mid,ax,k;
+	real dx,dy,dz,d2,diff;
+
+	if(hi<=lo) return;
+	mid=(lo+hi)/2;
+	k=kd->idx[mid];
+	dx=p[0]-kd->x[3*k];
+	dy=p[1]-kd->x[3*k+1];
+	dz=p[2]-kd->x[3*k+2];
+	d2=dx*dx+dy*dy+dz*dz;
+	if(d2<*best_d2)
+	{
+		*best_d2=d2;
+		*best=k;
+	}
+	ax=kd->axis[mid];
+	diff=p[ax]-kd->x[3*k+ax];
+	if(diff<0)
+	{
+		kd_nearest_range(kd,lo,mid,p,best,best_d2);
+		if(diff*diff<*best_d2) kd_nearest_range(kd,mid+1,hi,p,best,best_d2);
+	}
+	else
+	{
+		kd_nearest_range(kd,mid+1,hi,p,best,best_d2);
+		if(diff*diff<*best_d2) kd_nearest_range(kd,lo,mid,p,best,best_d2);
+	}
+}
+
+static int kd_nearest(const udf_kdtree *kd,const real p[3],real *d2)
+{
+	//index of the point closest to p, -1 for an empty tree
+	int best=-1;
+	real best_d2=1e30;
+
+	kd_nearest_range(kd,0,kd->n,p,&best,&best_d2);
+	if(d2!=NULL) *d2=best_d2;
+	return best;
+}
+
+static void kd_free(udf_kdtree *kd)
+{
+	free(kd->idx);
+	free(kd->axis);
+	kd->idx=NULL;
+	kd->axis=NULL;
+	kd->n=0;
+}
+
+#endif
@@ -0,0 +1,35 @@
+/**************************************************************************
+                            mesh stamp
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Cheap fingerprint of the mesh held by this process: the cell and face
+counts of all threads (one THREAD_N_ELEMENTS per thread, no element loop).
+Adaption and reading another case change it, so every cache built from
+the mesh (cell/face maps, geometry sums) keeps the stamp it was built with
+and rebuilds itself when udf_mesh_stamp() no longer matches, without a
+manual reset after adapting. UDF_MESH_UNKNOWN marks a cache whose stamp
+is not known yet (e.g. restored from a case/data file).
+**************************************************************************/
+
+#ifndef UDF_MESH_H
+#define UDF_MESH_H
+
+#define UDF_MESH_UNKNOWN (-1LL)
+
+static long long udf_mesh_stamp(Domain *domain)
+{
+	Thread *t;
+	long long nc=0,nf=0;
+
+	thread_loop_c(t,domain)
+	{
+		nc+=THREAD_N_ELEMENTS(t);
+	}
+	thread_loop_f(t,domain)
+	{
+		nf+=THREAD_N_ELEMENTS(t);
+	}
+	return (nc<<32)^nf;
+}
+
+#endif
@@ -0,0 +1,369 @@
+/**************************************************************************
+                      facade pressure coefficients
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file extracts the area-averaged pressure coefficient and mean wind
+speed of many window/vent openings on the building walls, e.g. as the
+boundary conditions of coupled indoor-outdoor ventilation (airflow network)
+models:
+    Cp=(p-P_REF)/(0.5*RHO*UREF^2)
+The openings are read from OPENING_FILE, one "id xmin ymin zmin xmax ymax
+zmax" box per line (thin across the wall). They are matched once to the
+wall faces through a uniform grid over the opening boxes, giving a sparse
+face->opening map of the wall faces that lie in an opening; every
+extraction is then one pass over the mapped faces. In parallel every node
+maps its principal faces, the sums of all nodes are combined and node 0
+writes the table. The UDF file includes
+the following terms:
+1  opening catalogue and face map (facade_setup);
+2  Cp & |U| of all openings on demand (facade_cp);
+3  Cp & |U| every FACADE_EVERY iterations/time steps (facade_cp_end);
+**************************************************************************/
+
+#include "udf.h"
+#include <string.h>
+#include "udf_mesh.h"
+
+#define OPENING_FILE "openings.txt"
+#define FACADE_OUT "facade_cp.txt"  //one block of rows per extraction
+#define FACADE_EVERY 100
+#define UREF 7.84                   //reference velocity (m/s), UH of the inlet profile
+#define RHO 1.29                    //density of air (kg/m3)
+#define P_REF 0.                    //reference static pressure (Pa)
+#define TOL 0.01                    //tolerance of the opening boxes (m)
+#define GRID_H 2.0                  //bin size of the opening grid (m)
+#define GRID_MAX (1<<22)            //most grid bins, GRID_H grows beyond
+
+static int n_open=0;
+static int *op_id=NULL;             //opening ids of the catalogue
+static real *op_box=NULL;           //6 per opening: xmin,ymin,zmin,xmax,ymax,zmax
+static int n_map=0;
+static Thread **map_t=NULL;         //sparse face->opening map
+static face_t *map_f=NULL;
+static int *map_o=NULL;
+static long long map_stamp=UDF_MESH_UNKNOWN;	//mesh of the face map
+
+static int opening_read(void)
+{
+	FILE *fp;
+	double b[6];
+	int *gi;
+	real *gb;
+	int id,n=0,cap=1024;
+
+	fp=fopen(OPENING_FILE,"r");
+	if(fp==NULL)
+	{
+		Message("facade_setup: cannot open %s\n",OPENING_FILE);
+		return 0;
+	}
+	free(op_id);
+	free(op_box);
+	op_id=(int *)malloc(cap*sizeof(int));
+	op_box=(real *)malloc(6*cap*sizeof(real));
+	if(op_id==NULL || op_box==NULL)
+	{
+		Message("facade_setup: out of memory reading %s\n",OPENING_FILE);
+		fclose(fp);
+		return 0;
+	}
+	while(fscanf(fp,"%d %lf %lf %lf %lf %lf %lf",&id,&b[0],&b[1],&b[2],&b[3],&b[4],&b[5])==7)
+	{
+		int d;
+		if(n==cap)
+		{
+			gi=(int *)realloc(op_id,2*cap*sizeof(int));
+			if(gi!=NULL) op_id=gi;
+			gb=(real *)realloc(op_box,6*2*cap*sizeof(real));
+			if(gb!=NULL) op_box=gb;
+			if(gi==NULL || gb==NULL)
+			{
+				Message("facade_setup: out of memory, only the first %d openings of %s are used\n",n,OPENING_FILE);
+				break;
+			}
+			cap=2*cap;
+		}
+		op_id[n]=id;
+		for(d=0;d<3;d++)
+		{
+			op_box[6*n+d]=MIN(b[d],b[d+3])-TOL;
+			op_box[6*n+3+d]=MAX(b[d],b[d+3])+TOL;
+		}
+		n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+/*************************opening catalogue & face map**********************/
+
+DEFINE_ON_DEMAND(facade_setup)
+{
+	//every node maps the principal wall faces it owns
+#if !RP_HOST
+	Domain *domain;
+	Thread *t;
+	face_t f;
+	real x[ND_ND];
+	real lo[3],hi[3],h=GRID_H;
+	int nb[3],*start,*list=NULL,*fill=NULL,*go;
+	Thread **gt;
+	face_t *gf;
+	int j,d,i0[3],i1[3],a,b,c,k,g,n_bin,cap,full=0,n_all;
+	domain=Get_Domain(1);
+
+	n_open=opening_read();
+	n_map=0;
+	if(n_open==0)
+	{
+		return;
+	}
+
+	//uniform grid over the opening boxes, each opening listed in every bin it overlaps
+	for(d=0;d<3;d++)
+	{
+		lo[d]=op_box[d];
+		hi[d]=op_box[3+d];
+	}
+	for(j=1;j<n_open;j++)
+	{
+		for(d=0;d<3;d++)
+		{
+			lo[d]=MIN(lo[d],op_box[6*j+d]);
+			hi[d]=MAX(hi[d],op_box[6*j+3+d]);
+		}
+	}
+	do
+	{
+		for(d=0;d<3;d++)
+		{
+			nb[d]=(int)((hi[d]-lo[d])/h)+1;
+		}
+		n_bin=nb[0]*nb[1]*nb[2];
+		h=2*h;
+	} while(n_bin>GRID_MAX || n_bin<=0);
+	h=h/2;
+	start=(int *)calloc(n_bin+1,sizeof(int));
+	if(start==NULL)
+	{
+		Message("facade_setup: out of memory for %d grid bins\n",n_bin);
+		n_open=0;
+		return;
+	}
+	for(k=0;k<2;k++)	//count, then fill
+	{
+		if(k==1)
+		{
+			for(g=0;g<n_bin;g++) start[g+1]+=start[g];
+			list=(int *)malloc((start[n_bin]>0?start[n_bin]:1)*sizeof(int));
+			fill=(int *)malloc(n_bin*sizeof(int));
+			if(list==NULL || fill==NULL)
+			{
+				Message("facade_setup: out of memory for the opening grid\n");
+				free(start);
+				free(list);
+				free(fill);
+				n_open=0;
+				return;
+			}
+			memcpy(fill,start,n_bin*sizeof(int));
+		}
+		for(j=0;j<n_open;j++)
+		{
+			for(d=0;d<3;d++)
+			{
+				i0[d]=(int)((op_box[6*j+d]-lo[d])/h);
+				i1[d]=MIN((int)((op_box[6*j+3+d]-lo[d])/h),nb[d]-1);
+			}
+			for(a=i0[0];a<=i1[0];a++) for(b=i0[1];b<=i1[1];b++) for(c=i0[2];c<=i1[2];c++)
+			{
+				g=(a*nb[1]+b)*nb[2]+c;
+				if(k==0) start[g+1]++;
+				else list[fill[g]++]=j;
+			}
+		}
+	}
+	free(fill);
+
+	//sparse face->opening map of the wall faces inside an opening box
+	free(map_t);
+	free(map_f);
+	free(map_o);
+	cap=1024;
+	map_t=(Thread **)malloc(cap*sizeof(Thread *));
+	map_f=(face_t *)malloc(cap*sizeof(face_t));
+	map_o=(int *)malloc(cap*sizeof(int));
+	full=(map_t==NULL || map_f==NULL || map_o==NULL);
+	thread_loop_f(t,domain)
+	{
+		if(THREAD_TYPE(t)!=THREAD_F_WALL || full) continue;
+		begin_f_loop(f,t)
+		{
+			if(!PRINCIPAL_FACE_P(f,t) || full) continue;	//partition boundary faces are summed by one node
+			F_CENTROID(x,f,t);
+			for(d=0;d<3;d++)
+			{
+				i0[d]=(int)floor((x[d]-lo[d])/h);
+			}
+			if(i0[0]<0 || i0[0]>=nb[0] || i0[1]<0 || i0[1]>=nb[1] || i0[2]<0 || i0[2]>=nb[2]) continue;
+			g=(i0[0]*nb[1]+i0[1])*nb[2]+i0[2];
+			for(k=start[g];k<start[g+1];k++)
+			{
+				j=list[k];
+				if(x[0]>=op_box[6*j] && x[0]<=op_box[6*j+3] && x[1]>=op_box[6*j+1] && x[1]<=op_box[6*j+4] && x[2]>=op_box[6*j+2] && x[2]<=op_box[6*j+5])
+				{
+					if(n_map==cap)
+					{
+						gt=(Thread **)realloc(map_t,2*cap*sizeof(Thread *));
+						if(gt!=NULL) map_t=gt;
+						gf=(face_t *)realloc(map_f,2*cap*sizeof(face_t));
+						if(gf!=NULL) map_f=gf;
+						go=(int *)realloc(map_o,2*cap*sizeof(int));
+						if(go!=NULL) map_o=go;
+						if(gt==NULL || gf==NULL || go==NULL)
+						{
+							full=1;	//keeps the faces mapped so far
+							break;
+						}
+						cap=2*cap;
+					}
+					map_t[n_map]=t;
+					map_f[n_map]=f;
+					map_o[n_map]=j;
+					n_map++;
+					break;	//first matching opening only
+				}
+			}
+		}
+		end_f_loop(f,t)
+	}
+	free(start);
+	free(list);
+	if(map_t==NULL || map_f==NULL || map_o==NULL)
+	{
+		free(map_t);
+		free(map_f);
+		free(map_o);
+		map_t=NULL;
+		map_f=NULL;
+		map_o=NULL;
+		n_map=0;
+	}
+	if(full)
+	{
+		Message("facade_setup: out of memory, only %d wall faces mapped\n",n_map);
+	}
+	map_stamp=udf_mesh_stamp(domain);
+	n_all=n_map;
+#if RP_NODE
+	n_all=PRF_GISUM1(n_all);
+	if(I_AM_NODE_ZERO_P)
+#endif
+	Message("facade_setup: %d openings, %d wall faces mapped (grid %d x %d x %d of %g m)\n",n_open,n_all,nb[0],nb[1],nb[2],h);
+#endif
+}
+
+/*****************************Cp & |U| of openings*************************/
+
+static void facade_write(void)
+{
+	//area, area-weighted p and |U| summed over the owned faces of all nodes, written by node 0
+#if !RP_HOST
+	Thread *t,*t0;
+	face_t f;
+	cell_t c0;
+	real NV_VEC(A);
+	real a,q;
+	real *sa,*sp,*su;
+	int k,j,empty=0,changed;
+#if RP_NODE
+	real *work;
+#endif
+
+	if(n_open==0 || map_o==NULL)
+	{
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("facade_cp: run facade_setup first\n");
+		return;
+	}
+	changed=(map_stamp!=udf_mesh_stamp(Get_Domain(1)));
+#if RP_NODE
+	changed=PRF_GISUM1(changed);
+#endif
+	if(changed)
+	{
+		facade_setup();	//mesh adapted since the faces were mapped
+		if(n_open==0 || map_o==NULL) return;
+	}
+	sa=(real *)calloc(3*n_open,sizeof(real));
+	if(sa==NULL)
+	{
+		Error("facade_cp: out of memory for %d openings\n",n_open);
+		return;
+	}
+	sp=sa+n_open;
+	su=sa+2*n_open;
+	for(k=0;k<n_map;k++)
+	{
+		t=map_t[k];
+		f=map_f[k];
+		j=map_o[k];
+		c0=F_C0(f,t);
+		t0=F_C0_THREAD(f,t);
+		if(!FLUID_THREAD_P(t0)) continue;	//solid side of a coupled wall: no velocity (its fluid shadow is mapped too)
+		F_AREA(A,f,t);
+		a=NV_MAG(A);
+		sa[j]+=a;
+		sp[j]+=F_P(f,t)*a;
+		su[j]+=sqrt(C_U(c0,t0)*C_U(c0,t0)+C_V(c0,t0)*C_V(c0,t0)+C_W(c0,t0)*C_W(c0,t0))*a;	//wall-adjacent cell
+	}
+#if RP_NODE
+	work=(real *)malloc(3*n_open*sizeof(real));
+	PRF_GRSUM(sa,3*n_open,work);	//openings straddling partitions
+	free(work);
+	if(I_AM_NODE_ZERO_P)
+#endif
+	{
+		FILE *fp=fopen(FACADE_OUT,"a");
+		if(fp!=NULL)
+		{
+			setvbuf(fp,NULL,_IOFBF,1<<20);
+			q=0.5*RHO*UREF*UREF;
+			fprintf(fp,"# iteration %d time %g openings %d\n# id area Cp |U|\n",N_ITER,CURRENT_TIME,n_open);
+			for(j=0;j<n_open;j++)
+			{
+				if(sa[j]>0)
+				{
+					fprintf(fp,"%d %g %g %g\n",op_id[j],sa[j],(sp[j]/sa[j]-P_REF)/q,su[j]/sa[j]);
+				}
+				else
+				{
+					fprintf(fp,"%d 0 nan nan\n",op_id[j]);	//no wall face centroid inside the opening
+					empty++;
+				}
+			}
+			fclose(fp);
+		}
+		if(empty>0)
+		{
+			Message("facade_cp: %d openings without wall faces\n",empty);
+		}
+	}
+	free(sa);
+#endif
+}
+
+DEFINE_ON_DEMAND(facade_cp)
+{
+	facade_write();
+}
+
+DEFINE_EXECUTE_AT_END(facade_cp_end)
+{
+	int n=RP_Get_Boolean("rp-unsteady?")?N_TIME:N_ITER;
+
+	if(n%FACADE_EVERY!=0) return;
+	facade_write();
+}
@@ -0,0 +1,220 @@
+/**************************************************************************
+                          ground roughness
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file gives every ground face its own aerodynamic roughness from a
+land-use or roughness-length raster, instead of the single terrain
+roughness implied by the inlet profiles. The raster (ESRI ASCII grid,
+ROUGHNESS_FILE) holds z0 (m) or, with LANDUSE_CLASSES, land-use classes
+that are converted with z0_class[]. It is read once and converted to the
+sand-grain roughness height of the standard wall functions
+    Ks=9.793*z0/Cs     (Blocken et al., 2007)
+per pixel. The pixel of each face is found once and kept as pixel+1 in
+F_UDMI(f,t,UDM_PIX) (0: not mapped yet, -1: outside the raster,
+N_UDM >= UDM_PIX+1; exact up to 2^24 pixels in single precision), so every
+later call is one memory read and one table lookup. The map is cleared
+and rebuilt when the cell or face count changes (adaption, udf_mesh.h),
+since adapted faces inherit the pixel of their parent. Set the roughness
+constant of the wall to CS. The UDF file includes the following terms:
+1  profile term of the wall roughness height (roughness_height);
+2  re-reading of the raster and remapping of the faces (roughness_reset);
+**************************************************************************/
+
+#include "udf.h"
+#include <ctype.h>
+#include <string.h>
+#include "udf_mesh.h"
+
+#define ROUGHNESS_FILE "roughness.asc"
+#define LANDUSE_CLASSES 0    //1: the raster holds land-use classes, 0: z0 in m
+#define N_CLASS 8
+#define CS 0.5               //roughness constant of the wall (Cs)
+#define Z0_DEFAULT 0.03      //z0 outside the raster and for NODATA pixels (m)
+#define GX 0                 //model axis along the raster columns (east)
+#define GY 1                 //model axis along the raster rows (north)
+#define GEO_X0 0.            //map coordinates of the model origin, as in the raster export
+#define GEO_Y0 0.
+#define UDM_PIX 0            //face UDM of the pixel index (1 is UDM_SVF of udf_of_solar_radiation.c)
+
+//z0 (m) of land-use classes 0..N_CLASS-1: water, grass, crops, shrub, suburb, forest, city, city centre
+static const real z0_class[N_CLASS]={0.0002,0.03,0.1,0.25,0.5,1.0,1.5,2.0};
+
+static int rg_nx=0,rg_ny=0;
+static double rg_x0,rg_y0,rg_dx;
+static float *rg_ks=NULL;   //Ks per pixel, row 0 at the bottom (south)
+static int rg_missing=0;    //the raster could not be read
+static long long rg_stamp=UDF_MESH_UNKNOWN;	//mesh of the pixel map in F_UDMI
+
+static real ks_of(real z0)
+{
+	return 9.793*z0/CS;
+}
+
+static int roughness_read(void)
+{
+	FILE *fp;
+	char key[32];
+	double v,nodata=-9999.;
+	int i,j,k,n,center=0;
+
+	fp=fopen(ROUGHNESS_FILE,"r");
+	if(fp==NULL)
+	{
+		Message("roughness: cannot open %s, z0=%g everywhere\n",ROUGHNESS_FILE,Z0_DEFAULT);
+		return 0;
+	}
+	rg_nx=rg_ny=0;
+	rg_x0=rg_y0=0;
+	rg_dx=1;
+	for(k=0;k<6 && fscanf(fp,"%31s %lf",key,&v)==2;k++)
+	{
+		for(i=0;key[i];i++) key[i]=(char)tolower((unsigned char)key[i]);
+		if(strcmp(key,"ncols")==0) rg_nx=(int)v;
+		else if(strcmp(key,"nrows")==0) rg_ny=(int)v;
+		else if(strcmp(key,"xllcorner")==0) rg_x0=v;
+		else if(strcmp(key,"yllcorner")==0) rg_y0=v;
+		else if(strcmp(key,"xllcenter")==0) {rg_x0=v; center=1;}
+		else if(strcmp(key,"yllcenter")==0) rg_y0=v;
+		else if(strcmp(key,"cellsize")==0) rg_dx=v;
+		else if(strcmp(key,"nodata_value")==0) nodata=v;
+	}
+	if(rg_nx<=0 || rg_ny<=0)
+	{
+		fclose(fp);
+		return 0;
+	}
+	if(center)
+	{
+		rg_x0=rg_x0-0.5*rg_dx;	//lower-left corner from the centre of the lower-left pixel
+		rg_y0=rg_y0-0.5*rg_dx;
+	}
+	free(rg_ks);
+	rg_ks=(float *)malloc((size_t)rg_nx*rg_ny*sizeof(float));
+	n=0;
+	for(j=rg_ny-1;j>=0;j--)	//the first row of the file is the northern one
+	{
+		for(i=0;i<rg_nx;i++)
+		{
+			if(fscanf(fp,"%lf",&v)!=1)
+			{
+				v=nodata;
+			}
+			else
+			{
+				n++;
+			}
+			if(v==nodata)
+			{
+				v=Z0_DEFAULT;
+			}
+			else if(LANDUSE_CLASSES)
+			{
+				k=(int)v;
+				v=(k>=0 && k<N_CLASS)?z0_class[k]:Z0_DEFAULT;
+			}
+			rg_ks[(size_t)j*rg_nx+i]=(float)ks_of(v);
+		}
+	}
+	fclose(fp);
+	Message("roughness: %d x %d pixels of %g m read from %s (%d values)\n",rg_nx,rg_ny,rg_dx,ROUGHNESS_FILE,n);
+	return 1;
+}
+
+static int pixel_of(real x[ND_ND])
+{
+	//pixel index of a model point, -1 outside the raster
+	int i=(int)floor((x[GX]+GEO_X0-rg_x0)/rg_dx);
+	int j=(int)floor((x[GY]+GEO_Y0-rg_y0)/rg_dx);
+
+	if(i<0 || i>=rg_nx || j<0 || j>=rg_ny)
+	{
+		return -1;
+	}
+	return j*rg_nx+i;
+}
+
+static void roughness_unmap(Domain *domain)
+{
+	//pixel map of all wall faces to be rebuilt on their next call
+	Thread *t;
+	face_t f;
+
+	if(N_UDM<=UDM_PIX)
+	{
+		return;
+	}
+	thread_loop_f(t,domain)
+	{
+		if(THREAD_TYPE(t)!=THREAD_F_WALL) continue;
+		begin_f_loop(f,t)
+		{
+			F_UDMI(f,t,UDM_PIX)=0;
+		}
+		end_f_loop(f,t)
+	}
+}
+
+/**********************profile term of roughness height*********************/
+
+DEFINE_PROFILE(roughness_height,t,i)
+{
+	face_t f;
+	real x[ND_ND];
+	real u;
+	int k,cached=(N_UDM>UDM_PIX);
+	long long stamp=udf_mesh_stamp(Get_Domain(1));
+
+	if(rg_ks==NULL && !rg_missing)
+	{
+		rg_missing=!roughness_read();
+	}
+	if(rg_stamp==UDF_MESH_UNKNOWN)
+	{
+		rg_stamp=stamp;	//first call, or the map restored with the data file
+	}
+	else if(rg_stamp!=stamp)
+	{
+		roughness_unmap(Get_Domain(1));
+		rg_stamp=stamp;
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("roughness: mesh changed, ground faces remapped to the raster\n");
+	}
+	begin_f_loop(f,t)
+	{
+		if(rg_missing)
+		{
+			F_PROFILE(f,t,i)=ks_of(Z0_DEFAULT);
+			continue;
+		}
+		u=cached?F_UDMI(f,t,UDM_PIX):0;
+		if(u==0)
+		{
+			F_CENTROID(x,f,t);
+			k=pixel_of(x);
+			if(cached)
+			{
+				F_UDMI(f,t,UDM_PIX)=(k>=0)?k+1:-1;	//-1: mapped, outside the raster
+			}
+		}
+		else
+		{
+			k=(int)u-1;
+		}
+		F_PROFILE(f,t,i)=(k>=0 && k<rg_nx*rg_ny)?rg_ks[k]:ks_of(Z0_DEFAULT);	//stale maps of another raster fall back too
+	}
+	end_f_loop(f,t)
+}
+
+/****************************raster re-reading*****************************/
+
+DEFINE_ON_DEMAND(roughness_reset)
+{
+	Domain *domain;
+	domain=Get_Domain(1);
+
+	rg_missing=!roughness_read();
+	roughness_unmap(domain);
+	rg_stamp=udf_mesh_stamp(domain);
+}
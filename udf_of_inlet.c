@@ -8,9 +8,19 @@ including the following terms:
 1  profile term of inlet velocity
 2  profile term of inlet k
 3  profile term of inlet e
+4  hot-path counters report & reset (only built with UDF_COUNTERS)
+5  profile terms of the inlet velocity components for a wind direction
+6  fast math switch & check (inlet_fastmath_on/off/check)
+7  profile terms of u, v, w, k & e recycled from a precursor sampling plane,
+   updated by the adjust function recycle_update
 **************************************************************************/
 
 #include "udf.h"
+#include <string.h>
+#include "udf_counters.h"
+#include "udf_fastmath.h"
+#include "udf_kdtree.h"
+#include "udf_mesh.h"
 
 #define UH 4.8                //reference velocity
 #define H 20                  //height of buildings
@@ -19,6 +29,28 @@ including the following terms:
 #define Utau 0.23             //friction velocity
 #define K 0.435               //von Karman constant
 #define Cmu 0.09
+#define WIND_DIR 0.           //wind direction (deg) from +x towards +z, used if udf/wind-dir is not defined
+
+#define PLANE_X -200.         //sampling plane x=PLANE_X in the upstream precursor region
+#define PRECURSOR_ID -1       //cell zone ID of the precursor region, -1: all fluid zones
+#define DELTA_P 300           //boundary layer depth of the precursor flow
+#define N_RECYCLE_T 16        //most inlet face threads using the recycled profiles
+
+enum {CNT_VELOCITY_PROFILE,CNT_K_PROFILE,CNT_E_PROFILE,CNT_VELOCITY_X_PROFILE,CNT_VELOCITY_Z_PROFILE};
+#ifdef UDF_COUNTERS
+UDF_COUNTERS_TABLE {{"velocity_profile"},{"k_profile"},{"e_profile"},{"velocity_x_profile"},{"velocity_z_profile"}};
+#endif
+
+static real wind_dir(void)
+{
+	//direction (rad) from the scheme variable udf/wind-dir, so that one compiled
+	//library serves all directions: (rp-var-define 'udf/wind-dir 30. 'real #f)
+	if(RP_Variable_Exists_P("udf/wind-dir"))
+	{
+		return RP_Get_Real("udf/wind-dir")*M_PI/180.;
+	}
+	return WIND_DIR*M_PI/180.;
+}
 
 /*********************profile term of inlet velocity**********************/
 
@@ -27,6 +59,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
 	real x[ND_ND];
 	real h;
 	face_t f;
+	UDF_COUNTER_BEGIN;
 
 	begin_f_loop(f,t)
 	{
@@ -35,7 +68,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
       
 		if(h<=DELTA && h>=0)
         	{
-			F_PROFILE(f,t,i)=UH*pow(h/DELTA,A);
+			F_PROFILE(f,t,i)=UH*UDF_FAST_POW(h/DELTA,A);
         	}
         	else
         	{
@@ -44,6 +77,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_VELOCITY_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /************************profile term of inlet k**************************/
@@ -53,6 +87,7 @@ DEFINE_PROFILE(k_profile,t,i)
 	real x[ND_ND];
 	real h;
 	face_t f;
+	UDF_COUNTER_BEGIN;
   
 	begin_f_loop(f,t)
 	{
@@ -70,6 +105,7 @@ DEFINE_PROFILE(k_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_K_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /*************************profile term of inlet e**************************/
@@ -79,6 +115,7 @@ DEFINE_PROFILE(e_profile,t,i)
 	real x[ND_ND];
 	real h;
 	face_t f;
+	UDF_COUNTER_BEGIN;
   
 	begin_f_loop(f,t)
 	{
@@ -96,4 +133,424 @@ DEFINE_PROFILE(e_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_E_PROFILE,THREAD_N_ELEMENTS_INT(t));
+}
+
+/**************profile terms of inlet velocity components****************/
+
+DEFINE_PROFILE(velocity_x_profile,t,i)
+{
+	real x[ND_ND];
+	real h,u;
+	real c=cos(wind_dir());
+	face_t f;
+	UDF_COUNTER_BEGIN;
+
+	begin_f_loop(f,t)
+	{
+		F_CENTROID(x,f,t);
+		h=x[1];
+		u=(h<=DELTA && h>=0)?UH*UDF_FAST_POW(h/DELTA,A):UH;
+		F_PROFILE(f,t,i)=u*c;
+	}
+	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_VELOCITY_X_PROFILE,THREAD_N_ELEMENTS_INT(t));
+}
+
+DEFINE_PROFILE(velocity_z_profile,t,i)
+{
+	real x[ND_ND];
+	real h,u;
+	real s=sin(wind_dir());
+	face_t f;
+	UDF_COUNTER_BEGIN;
+
+	begin_f_loop(f,t)
+	{
+		F_CENTROID(x,f,t);
+		h=x[1];
+		u=(h<=DELTA && h>=0)?UH*UDF_FAST_POW(h/DELTA,A):UH;
+		F_PROFILE(f,t,i)=u*s;
+	}
+	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_VELOCITY_Z_PROFILE,THREAD_N_ELEMENTS_INT(t));
+}
+
+/*****************inflow recycled from a precursor plane*******************/
+
+//recycle_update (adjust) gathers the plane cells of all compute nodes once (centroid and
+//size) and their u,v,w,k,e once per time step, so that every node holds the whole plane;
+//all collective calls are made there. The profiles only read: inlet face k of thread
+//rc_thread[n] takes the plane cell rc_j[rc_off[n]+k], found on first use by a k-d tree
+//search at the height scaled by DELTA_P/DELTA, and the values are rescaled so that the
+//plane velocity at H*DELTA_P/DELTA becomes the target UH*(H/DELTA)^A at H
+static int n_plane=0;                 //plane cells of all nodes
+static int plane_0=0,n_own=0;         //block of the plane cells of this node
+static real *plane_x=NULL;            //3 per plane cell: centroid
+static real *plane_d=NULL;            //size cbrt(volume) of the plane cell
+static real *plane_v=NULL;            //5 per plane cell: u,v,w,k,e of the current time step
+static Thread **plane_t=NULL;         //own plane cells
+static cell_t *plane_c=NULL;
+static udf_kdtree plane_kd;
+static int n_rc_t=0;
+static Thread *rc_thread[N_RECYCLE_T];
+static int rc_off[N_RECYCLE_T+1];
+static int *rc_j=NULL;
+static real rc_scale=1;               //velocity scale of the current time step
+static int rc_step=-1;                //time step of plane_v, -1: no values yet
+static int rc_warned=0;
+static long long rc_stamp=UDF_MESH_UNKNOWN;	//mesh the plane and the maps were built on
+
+static void recycle_free(void)
+{
+	if(plane_x!=NULL)
+	{
+		kd_free(&plane_kd);
+	}
+	free(plane_x); free(plane_d); free(plane_v); free(plane_t); free(plane_c); free(rc_j);
+	plane_x=NULL; plane_d=NULL; plane_v=NULL; plane_t=NULL; plane_c=NULL; rc_j=NULL;
+	n_plane=0;
+	plane_0=0;
+	n_own=0;
+	n_rc_t=0;
+	rc_step=-1;
+	rc_warned=0;
+}
+
+static void recycle_plane(void)
+{
+	//cells of the precursor cut by the plane x=PLANE_X, own ones first, then all nodes
+	Domain *domain;
+	Thread *t,**pt;
+	cell_t c,*pc;
+	real x[ND_ND];
+	real *px,*pd,*gx,*gd;
+	int cap=1024,j,ok;
+#if RP_NODE
+	int *cnt,*iwork;
+	real *work;
+#endif
+	domain=Get_Domain(1);
+
+	n_own=0;
+	px=(real *)malloc(3*cap*sizeof(real));
+	pd=(real *)malloc(cap*sizeof(real));
+	plane_t=(Thread **)malloc(cap*sizeof(Thread *));
+	plane_c=(cell_t *)malloc(cap*sizeof(cell_t));
+	ok=(px!=NULL && pd!=NULL && plane_t!=NULL && plane_c!=NULL);
+	thread_loop_c(t,domain)
+	{
+		if(!ok || !FLUID_THREAD_P(t) || (PRECURSOR_ID>=0 && THREAD_ID(t)!=PRECURSOR_ID)) continue;
+		begin_c_loop_int(c,t)
+		{
+			C_CENTROID(x,c,t);
+			if(!ok || fabs(x[0]-PLANE_X)>0.5*cbrt(C_VOLUME(c,t))) continue;
+			if(n_own==cap)
+			{
+				gx=(real *)realloc(px,3*2*cap*sizeof(real));
+				if(gx!=NULL) px=gx;
+				gd=(real *)realloc(pd,2*cap*sizeof(real));
+				if(gd!=NULL) pd=gd;
+				pt=(Thread **)realloc(plane_t,2*cap*sizeof(Thread *));
+				if(pt!=NULL) plane_t=pt;
+				pc=(cell_t *)realloc(plane_c,2*cap*sizeof(cell_t));
+				if(pc!=NULL) plane_c=pc;
+				ok=(gx!=NULL && gd!=NULL && pt!=NULL && pc!=NULL);
+				if(!ok) continue;
+				cap=2*cap;
+			}
+			px[3*n_own]=PLANE_X;	//on the plane, so that the search is over y and z only
+			px[3*n_own+1]=x[1];
+			px[3*n_own+2]=x[2];
+			pd[n_own]=cbrt(C_VOLUME(c,t));
+			plane_t[n_own]=t;
+			plane_c[n_own]=c;
+			n_own++;
+		}
+		end_c_loop_int(c,t)
+	}
+	if(!ok)
+	{
+		//this node contributes no plane cells, the gather below still runs on every node
+		Message("recycle: out of memory for the plane cells of node %d\n",myid);
+		free(px); free(pd); free(plane_t); free(plane_c);
+		px=NULL; pd=NULL; plane_t=NULL; plane_c=NULL;
+		n_own=0;
+	}
+
+	//own block of the plane of all nodes
+	plane_0=0;
+	n_plane=n_own;
+#if RP_NODE
+	cnt=(int *)calloc(2*compute_node_count,sizeof(int));
+	iwork=cnt+compute_node_count;
+	cnt[myid]=n_own;
+	PRF_GISUM(cnt,compute_node_count,iwork);
+	for(j=0,n_plane=0;j<compute_node_count;j++)
+	{
+		if(j<myid) plane_0+=cnt[j];
+		n_plane+=cnt[j];
+	}
+	free(cnt);
+#endif
+	plane_x=(real *)calloc(3*(n_plane>0?n_plane:1),sizeof(real));
+	plane_d=(real *)calloc(n_plane>0?n_plane:1,sizeof(real));
+	plane_v=(real *)calloc(5*(n_plane>0?n_plane:1),sizeof(real));
+	for(j=0;j<n_own;j++)
+	{
+		plane_x[3*(plane_0+j)]=px[3*j];
+		plane_x[3*(plane_0+j)+1]=px[3*j+1];
+		plane_x[3*(plane_0+j)+2]=px[3*j+2];
+		plane_d[plane_0+j]=pd[j];
+	}
+	free(px);
+	free(pd);
+#if RP_NODE
+	work=(real *)malloc(3*(n_plane>0?n_plane:1)*sizeof(real));
+	PRF_GRSUM(plane_x,3*n_plane,work);
+	PRF_GRSUM(plane_d,n_plane,work);
+	free(work);
+#endif
+	kd_build(&plane_kd,plane_x,n_plane);
+#if RP_NODE
+	if(I_AM_NODE_ZERO_P)
+#endif
+	Message("recycle: %d precursor cells on the plane x=%g\n",n_plane,PLANE_X);
+}
+
+static void recycle_values(void)
+{
+	//plane values of all nodes and target over precursor velocity at the scaled
+	//reference height, once per time step
+	Thread *t;
+	cell_t c;
+	real u=0,w=0,h=(real)H*DELTA_P/DELTA;
+	int j,n=RP_Get_Boolean("rp-unsteady?")?N_TIME:N_ITER;
+#if RP_NODE
+	real *work;
+#endif
+
+	if(n==rc_step)
+	{
+		return;
+	}
+	memset(plane_v,0,5*n_plane*sizeof(real));
+	for(j=0;j<n_own;j++)
+	{
+		real *v=&plane_v[5*(plane_0+j)];
+		t=plane_t[j];
+		c=plane_c[j];
+		v[0]=C_U(c,t);
+		v[1]=C_V(c,t);
+		v[2]=C_W(c,t);
+		v[3]=NNULLP(THREAD_STORAGE(t,SV_K))?C_K(c,t):0;	//laminar precursor: no k & e
+		v[4]=NNULLP(THREAD_STORAGE(t,SV_D))?C_D(c,t):0;
+	}
+#if RP_NODE
+	work=(real *)malloc(5*n_plane*sizeof(real));
+	PRF_GRSUM(plane_v,5*n_plane,work);
+	free(work);
+#endif
+	for(j=0;j<n_plane;j++)
+	{
+		if(fabs(plane_x[3*j+1]-h)<=0.5*plane_d[j])
+		{
+			u=u+plane_v[5*j]*plane_d[j]*plane_d[j];
+			w=w+plane_d[j]*plane_d[j];
+		}
+	}
+	rc_scale=(u>0)?UH*pow((real)H/DELTA,A)/(u/w):1;
+	rc_step=n;
+}
+
+DEFINE_ADJUST(recycle_update,domain)
+{
+	//hook as an adjust function: the collective part of the recycled inflow, on all nodes
+#if !RP_HOST
+	long long stamp=udf_mesh_stamp(domain);
+	int changed=(stamp!=rc_stamp);
+
+#if RP_NODE
+	changed=PRF_GISUM1(changed);	//all nodes rebuild together, the plane is gathered
+#endif
+	if(changed)
+	{
+		//adapted or another mesh: cells and faces of the old maps are gone
+		recycle_free();
+		rc_stamp=stamp;
+	}
+	if(plane_x==NULL)
+	{
+		recycle_plane();
+	}
+	if(n_plane>0)
+	{
+		recycle_values();
+	}
+#endif
+}
+
+static int recycle_map(Thread *t)
+{
+	//block of the face->plane cell map of inlet thread t, built on first use from the
+	//gathered plane (no communication); -1 before recycle_update or without plane cells
+	face_t f;
+	real x[ND_ND],p[3];
+	int n,k,*rj;
+
+	if(plane_x==NULL || n_plane==0 || rc_step<0)
+	{
+		return -1;
+	}
+	for(n=0;n<n_rc_t;n++)
+	{
+		if(rc_thread[n]==t) return n;
+	}
+	if(n_rc_t==N_RECYCLE_T)
+	{
+		return -1;
+	}
+	if(n_rc_t==0)
+	{
+		rc_off[0]=0;
+	}
+	k=rc_off[n_rc_t]+THREAD_N_ELEMENTS_INT(t);
+	rj=(int *)realloc(rc_j,(k>0?k:1)*sizeof(int));
+	if(rj==NULL)
+	{
+		return -1;	//rc_j keeps the threads mapped so far
+	}
+	rc_j=rj;
+	k=rc_off[n_rc_t];
+	begin_f_loop(f,t)
+	{
+		F_CENTROID(x,f,t);
+		p[0]=PLANE_X;
+		p[1]=x[1]*DELTA_P/DELTA;
+		p[2]=x[2];
+		rc_j[k]=kd_nearest(&plane_kd,p,NULL);
+		k++;
+	}
+	end_f_loop(f,t)
+	rc_thread[n_rc_t]=t;
+	rc_off[++n_rc_t]=k;
+	return n_rc_t-1;
+}
+
+static real inlet_analytic(real h,int var)
+{
+	//profiles of terms 1-3 and 5 (velocity along udf/wind-dir)
+	real u=(h<=DELTA && h>=0)?UH*UDF_FAST_POW(h/DELTA,A):UH;
+
+	switch(var)
+	{
+	case 0: return u*cos(wind_dir());
+	case 1: return 0;
+	case 2: return u*sin(wind_dir());
+	case 3: return (h<=DELTA)?((Utau*Utau)/sqrt(Cmu))*(1-h/DELTA):0;
+	default: return (h<=DELTA)?((Utau*Utau*Utau)/(K*h))*(1-h/DELTA):0;
+	}
+}
+
+static void recycle_profile(Thread *t,int i,int var)
+{
+	//var: 0 u, 1 v, 2 w, 3 k, 4 e
+	face_t f;
+	real x[ND_ND];
+	real s,v;
+	int n,k;
+
+	n=recycle_map(t);
+	if(n<0)
+	{
+		if(!rc_warned)
+		{
+			Message("recycle: no plane values (recycle_update not hooked or not run yet, no precursor plane cells, too many inlet threads or out of memory), analytic inlet profiles used\n");
+			rc_warned=1;
+		}
+		begin_f_loop(f,t)
+		{
+			F_CENTROID(x,f,t);
+			F_PROFILE(f,t,i)=inlet_analytic(x[1],var);
+		}
+		end_f_loop(f,t)
+		return;
+	}
+	s=rc_scale;
+	k=rc_off[n];
+	begin_f_loop(f,t)
+	{
+		v=plane_v[5*rc_j[k]+var];
+		switch(var)
+		{
+		case 3: v=s*s*v; break;
+		case 4: v=s*s*s*v*DELTA_P/DELTA; break;	//e~U^3/L
+		default: v=s*v; break;
+		}
+		F_PROFILE(f,t,i)=v;
+		k++;
+	}
+	end_f_loop(f,t)
+}
+
+DEFINE_PROFILE(recycle_u_profile,t,i)
+{
+	recycle_profile(t,i,0);
+}
+
+DEFINE_PROFILE(recycle_v_profile,t,i)
+{
+	recycle_profile(t,i,1);
+}
+
+DEFINE_PROFILE(recycle_w_profile,t,i)
+{
+	recycle_profile(t,i,2);
+}
+
+DEFINE_PROFILE(recycle_k_profile,t,i)
+{
+	recycle_profile(t,i,3);
+}
+
+DEFINE_PROFILE(recycle_e_profile,t,i)
+{
+	recycle_profile(t,i,4);
+}
+
+DEFINE_ON_DEMAND(recycle_reset)
+{
+	//plane, k-d tree and face maps are rebuilt by the next recycle_update (done by itself after adaption)
+	recycle_free();
+}
+
+/***************************fast math switch******************************/
+
+DEFINE_ON_DEMAND(inlet_fastmath_on)
+{
+	udf_fast_math=1;
+}
+
+DEFINE_ON_DEMAND(inlet_fastmath_off)
+{
+	udf_fast_math=0;
+}
+
+DEFINE_ON_DEMAND(inlet_fastmath_check)
+{
+	fastmath_sweep();
+}
+
+/**************************hot-path counters****************************/
+
+#ifdef UDF_COUNTERS
+DEFINE_ON_DEMAND(inlet_counters_report)
+{
+	UDF_COUNTERS_REPORT("counters_inlet.txt")
+}
+
+DEFINE_ON_DEMAND(inlet_counters_reset)
+{
+	UDF_COUNTERS_RESET()
 }
+#endif
@@ -0,0 +1,244 @@
+/**************************************************************************
+                        particle dry deposition
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file adds the dry deposition of particles on walls as a sink in
+the wall-adjacent cells, for PM size bins carried as species. The
+deposition velocity follows the three-layer model of Lai & Nazaroff (2000),
+the same model as particledeposition.m: Brownian and turbulent diffusion
+across the boundary layer plus gravitational settling on upward-facing
+surfaces, vd=f(dp,u*,orientation). The model is evaluated once into a
+table over bin x orientation x log(u*) and interpolated per wall face, so
+each iteration costs a table lookup instead of the boundary-layer integral.
+The friction velocity is u*=Cmu^0.25*k^0.5 of the wall-adjacent cell. The
+sink of bin j in cell c is -rho*Y_j*sum(vd*A)/V with sum(vd*A) over the
+wall faces of c, kept in C_UDMI(c,t,UDM_DEP+j) (N_UDM >= UDM_DEP+N_BIN).
+The UDF file includes the following terms:
+1  deposition table and wall conductances sum(vd*A) (deposition_adjust);
+2  deposition sinks of the PM bins (pm_sink_0, pm_sink_1, pm_sink_2);
+3  deposition velocity table output (deposition_table);
+**************************************************************************/
+
+#include "udf.h"
+
+#define N_BIN 3              //PM size bins
+#define SPECIES_PM 0         //species index of the first bin, bins are consecutive
+#define UDM_DEP 8            //cell UDMs 8-10 of the bins; UDM_WC 0-3 of comfort, UDM_DECAY 4-6 & UDM_ADAPT 7 of the indices, UDM_CHEM 11-14
+#define RHO_P 1000.          //particle density (kg/m3)
+#define MU_AIR 1.81e-5       //air viscosity (Pa s)
+#define RHO_AIR 1.225        //air density (kg/m3)
+#define T_AIR 293.15         //air temperature (K)
+#define LAMBDA 0.065e-6      //mean free path of air (m)
+#define CMU 0.09
+#define UP 2                 //vertical axis
+#define N_US 64              //friction velocity points of the table
+#define US_MIN 0.001         //table range of u* (m/s)
+#define US_MAX 2.0
+
+static const real dp_bin[N_BIN]={0.5e-6,2.5e-6,10.e-6};	//representative diameters (m): PM1, PM2.5, PM10
+enum {DEP_UP,DEP_VERTICAL,DEP_DOWN,N_ORIENT};				//upward-facing (floor), vertical, downward-facing (ceiling)
+
+static real vd_table[N_BIN][N_ORIENT][N_US];
+static int vd_ready=0;
+
+/***********************Lai & Nazaroff deposition model*********************/
+
+static double nut_nu(double yp)
+{
+	//eddy to molecular viscosity ratio in the boundary layer
+	if(yp<4.3) return 7.669e-4*yp*yp*yp;
+	if(yp<12.5) return 1.00e-3*pow(yp,2.8214);
+	return 1.07e-2*pow(yp,1.8895);
+}
+
+static double vd_model(double dp,double us,int orient)
+{
+	double nu=MU_AIR/RHO_AIR;
+	double kn=2*LAMBDA/dp;
+	double cc=1+kn*(1.257+0.4*exp(-1.1/kn));								//Cunningham slip correction
+	double diff=1.380649e-23*T_AIR*cc/(3*M_PI*MU_AIR*dp);				//Brownian diffusivity
+	double vs=RHO_P*dp*dp*9.81*cc/(18*MU_AIR);							//settling velocity
+	double sc=nu/diff;
+	double rp=dp*us/(2*nu);
+	double integral=0,y0,y1,g0,g1;
+	int k,n=200;
+
+	//I=int_{r+}^{30} dy+/(nut/nu+1/Sc), trapezoid rule in log(y+)
+	if(rp<30)
+	{
+		y0=rp;
+		g0=y0/(nut_nu(y0)+1/sc);
+		for(k=1;k<=n;k++)
+		{
+			y1=rp*pow(30/rp,(double)k/n);
+			g1=y1/(nut_nu(y1)+1/sc);
+			integral=integral+0.5*(g0+g1)*log(y1/y0);
+			y0=y1;
+			g0=g1;
+		}
+	}
+	if(integral<=0)
+	{
+		return (orient==DEP_UP)?vs:0;
+	}
+	switch(orient)
+	{
+	case DEP_UP:
+		return vs/(1-exp(-vs*integral/us));
+	case DEP_DOWN:
+		return vs/(exp(vs*integral/us)-1);
+	default:
+		return us/integral;
+	}
+}
+
+static void vd_build(void)
+{
+	int j,o,k;
+
+	for(j=0;j<N_BIN;j++)
+	{
+		for(o=0;o<N_ORIENT;o++)
+		{
+			for(k=0;k<N_US;k++)
+			{
+				vd_table[j][o][k]=vd_model(dp_bin[j],US_MIN*pow(US_MAX/US_MIN,(double)k/(N_US-1)),o);
+			}
+		}
+	}
+	vd_ready=1;
+}
+
+static real vd_lookup(int j,int o,real us)
+{
+	//linear interpolation in log(u*), clamped to the table range
+	real s;
+	int k;
+
+	s=(N_US-1)*log(us/US_MIN)/log(US_MAX/US_MIN);
+	if(!(s>0)) return vd_table[j][o][0];
+	if(s>=N_US-1) return vd_table[j][o][N_US-1];
+	k=(int)s;
+	s=s-k;
+	return (1-s)*vd_table[j][o][k]+s*vd_table[j][o][k+1];
+}
+
+/*******************wall conductances of the adjacent cells*****************/
+
+DEFINE_ADJUST(deposition_adjust,domain)
+{
+	Thread *t,*t0;
+	cell_t c,c0;
+	face_t f;
+	real NV_VEC(A);
+	real a,nz,us;
+	int j,o;
+
+	if(N_UDM<UDM_DEP+N_BIN)
+	{
+		return;
+	}
+	if(!vd_ready)
+	{
+		vd_build();
+	}
+
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop(c,t)
+		{
+			for(j=0;j<N_BIN;j++)
+			{
+				C_UDMI(c,t,UDM_DEP+j)=0;
+			}
+		}
+		end_c_loop(c,t)
+	}
+
+	thread_loop_f(t,domain)
+	{
+		if(THREAD_TYPE(t)!=THREAD_F_WALL) continue;
+		begin_f_loop(f,t)
+		{
+			c0=F_C0(f,t);
+			t0=F_C0_THREAD(f,t);
+			if(!FLUID_THREAD_P(t0) || NULLP(THREAD_STORAGE(t0,SV_K))) continue;	//solid side of a coupled wall, or no k to give u*
+			F_AREA(A,f,t);
+			a=NV_MAG(A);
+			nz=-A[UP]/a;	//normal into the fluid
+			o=(nz>0.7)?DEP_UP:((nz<-0.7)?DEP_DOWN:DEP_VERTICAL);
+			us=pow(CMU,0.25)*sqrt(C_K(c0,t0));
+			for(j=0;j<N_BIN;j++)
+			{
+				C_UDMI(c0,t0,UDM_DEP+j)=C_UDMI(c0,t0,UDM_DEP+j)+vd_lookup(j,o,us)*a;
+			}
+		}
+		end_f_loop(f,t)
+	}
+}
+
+/*****************************deposition sinks******************************/
+
+static real pm_sink(cell_t c,Thread *t,real dS[],int eqn,int j)
+{
+	real g;
+
+	if(N_UDM<UDM_DEP+N_BIN)
+	{
+		dS[eqn]=0;
+		return 0;
+	}
+	g=C_R(c,t)*C_UDMI(c,t,UDM_DEP+j)/C_VOLUME(c,t);
+	dS[eqn]=-g;
+	return -g*C_YI(c,t,SPECIES_PM+j);
+}
+
+DEFINE_SOURCE(pm_sink_0,c,t,dS,eqn)
+{
+	return pm_sink(c,t,dS,eqn,0);
+}
+
+DEFINE_SOURCE(pm_sink_1,c,t,dS,eqn)
+{
+	return pm_sink(c,t,dS,eqn,1);
+}
+
+DEFINE_SOURCE(pm_sink_2,c,t,dS,eqn)
+{
+	return pm_sink(c,t,dS,eqn,2);
+}
+
+/************************deposition velocity table**************************/
+
+DEFINE_ON_DEMAND(deposition_table)
+{
+	FILE *fp;
+	int j,k;
+
+	if(!vd_ready)
+	{
+		vd_build();
+	}
+	fp=fopen("vd_table.txt","w");
+	if(fp==NULL)
+	{
+		return;
+	}
+	fprintf(fp,"u*(m/s)");
+	for(j=0;j<N_BIN;j++)
+	{
+		fprintf(fp," up_%gum vertical_%gum down_%gum",dp_bin[j]*1e6,dp_bin[j]*1e6,dp_bin[j]*1e6);
+	}
+	fprintf(fp,"\n");
+	for(k=0;k<N_US;k++)
+	{
+		fprintf(fp,"%g",US_MIN*pow(US_MAX/US_MIN,(double)k/(N_US-1)));
+		for(j=0;j<N_BIN;j++)
+		{
+			fprintf(fp," %g %g %g",vd_table[j][DEP_UP][k],vd_table[j][DEP_VERTICAL][k],vd_table[j][DEP_DOWN][k]);
+		}
+		fprintf(fp,"\n");
+	}
+	fclose(fp);
+}
@@ -0,0 +1,402 @@
+/**************************************************************************
+                                 probe sampling
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file samples velocity and concentration at many points, e.g. a
+pedestrian-level grid 1.5 m above ground for wind comfort and exposure.
+The probes are read from PROBE_FILE (one "x y z" per line), located once
+with a k-d tree over the cell centroids followed by a short cell walk to
+the containing cell, and the probe->cell map is kept for all later
+samples. In parallel each probe is sampled by the node owning its cell
+and node 0 writes all of them. Values are extrapolated from the cell
+centroid with the cell gradients when they are available (keep them with
+solve/set/expert -> "Keep temporary solver memory"). The UDF file includes
+the following terms:
+1  probe location (probe_setup);
+2  probe sampling on demand (probe_sample);
+3  probe sampling every PROBE_EVERY iterations/time steps (probe_sample_end);
+**************************************************************************/
+
+#include "udf.h"
+#include "udf_kdtree.h"
+#include "udf_mesh.h"
+
+#define PROBE_FILE "probes.txt"     //probe coordinates (m)
+#define PROBE_OUT "probes.dat"      //one block of rows per sample
+#define PROBE_EVERY 100
+#define SPECIES 0                   //sampled species
+#define WALK_MAX 50                 //maximum cell-walk steps from the nearest centroid
+
+static int n_probe=0;
+static real *probe_x=NULL;          //3*n_probe probe coordinates
+static Thread **probe_t=NULL;       //probe->cell map
+static cell_t *probe_c=NULL;
+static real *probe_dx=NULL;         //3*n_probe offsets from the cell centroid
+static long long probe_stamp=UDF_MESH_UNKNOWN;	//mesh of the probe->cell map
+
+static int probe_read(void)
+{
+	FILE *fp;
+	double p[3];
+	real *grow;
+	int n=0,cap=1024;
+
+	fp=fopen(PROBE_FILE,"r");
+	if(fp==NULL)
+	{
+		Message("probe_setup: cannot open %s\n",PROBE_FILE);
+		return 0;
+	}
+	free(probe_x);
+	probe_x=(real *)malloc(3*cap*sizeof(real));
+	if(probe_x==NULL)
+	{
+		Message("probe_setup: out of memory reading %s\n",PROBE_FILE);
+		fclose(fp);
+		return 0;
+	}
+	while(fscanf(fp,"%lf %lf %lf",&p[0],&p[1],&p[2])==3)
+	{
+		if(n==cap)
+		{
+			grow=(real *)realloc(probe_x,3*2*cap*sizeof(real));
+			if(grow==NULL)
+			{
+				Message("probe_setup: out of memory, only the first %d probes of %s are used\n",n,PROBE_FILE);
+				break;
+			}
+			cap=2*cap;
+			probe_x=grow;
+		}
+		probe_x[3*n]=p[0];
+		probe_x[3*n+1]=p[1];
+		probe_x[3*n+2]=p[2];
+		n++;
+	}
+	fclose(fp);
+	return n;
+}
+
+static int probe_walk(const real p[3],cell_t *c,Thread **t)
+{
+	//walk from *c towards p through the face the point lies most outside of;
+	//returns 1 once p is inside the cell, 0 if a boundary, the partition boundary
+	//(an exterior cell, owned by another node) or WALK_MAX is hit
+	real xf[ND_ND];
+	real NV_VEC(A);
+	real s,worst;
+	face_t f;
+	Thread *tf,*tn;
+	cell_t cn;
+	int n,step;
+
+	for(step=0;step<WALK_MAX;step++)
+	{
+		worst=0;
+		cn=-1;
+		tn=NULL;
+		c_face_loop(*c,*t,n)
+		{
+			f=C_FACE(*c,*t,n);
+			tf=C_FACE_THREAD(*c,*t,n);
+			F_CENTROID(xf,f,tf);
+			F_AREA(A,f,tf);
+			s=(p[0]-xf[0])*A[0]+(p[1]-xf[1])*A[1]+(p[2]-xf[2])*A[2];
+			if(F_C0(f,tf)!=*c || F_C0_THREAD(f,tf)!=*t)
+			{
+				s=-s;	//make A point out of this cell
+			}
+			s=s/NV_MAG(A);
+			if(s>worst)
+			{
+				worst=s;
+				if(BOUNDARY_FACE_THREAD_P(tf))
+				{
+					cn=-1;
+					tn=NULL;
+				}
+				else if(F_C0(f,tf)==*c && F_C0_THREAD(f,tf)==*t)
+				{
+					cn=F_C1(f,tf);
+					tn=F_C1_THREAD(f,tf);
+				}
+				else
+				{
+					cn=F_C0(f,tf);
+					tn=F_C0_THREAD(f,tf);
+				}
+			}
+		}
+		if(worst<=0)
+		{
+			return 1;
+		}
+		if(tn==NULL || cn>=THREAD_N_ELEMENTS_INT(tn))
+		{
+			return 0;
+		}
+		*c=cn;
+		*t=tn;
+	}
+	return 0;
+}
+
+/******************************probe location*****************************/
+
+DEFINE_ON_DEMAND(probe_setup)
+{
+	//every node locates the probes in its interior cells; a probe is sampled by the
+	//node whose cell contains it, or that reached the closest cell if none does
+#if !RP_HOST
+	Domain *domain;
+	Thread *t;
+	cell_t c;
+	real x[ND_ND];
+	real *cx,*r;
+	Thread **ct;
+	cell_t *cc;
+	udf_kdtree kd;
+	int *own;
+	int n_cell=0,n_all,k,j,outside=0,ok;
+#if RP_NODE
+	real *work;
+	int *iwork;
+#endif
+	domain=Get_Domain(1);
+
+	free(probe_t);
+	free(probe_c);
+	free(probe_dx);
+	probe_t=NULL;
+	probe_c=NULL;
+	probe_dx=NULL;
+	n_probe=probe_read();
+	if(n_probe==0)
+	{
+		return;
+	}
+
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		n_cell+=THREAD_N_ELEMENTS_INT(t);
+	}
+	n_all=n_cell;
+#if RP_NODE
+	n_all=PRF_GISUM1(n_all);	//a partition may hold no fluid cells
+#endif
+	if(n_all==0)
+	{
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("probe_setup: no fluid cells, %d probes not located\n",n_probe);
+		n_probe=0;
+		return;
+	}
+	cx=(real *)malloc(3*(n_cell>0?n_cell:1)*sizeof(real));
+	ct=(Thread **)malloc((n_cell>0?n_cell:1)*sizeof(Thread *));
+	cc=(cell_t *)malloc((n_cell>0?n_cell:1)*sizeof(cell_t));
+	r=(real *)malloc(2*n_probe*sizeof(real));
+	own=(int *)malloc(2*n_probe*sizeof(int));
+	probe_t=(Thread **)malloc(n_probe*sizeof(Thread *));
+	probe_c=(cell_t *)malloc(n_probe*sizeof(cell_t));
+	probe_dx=(real *)malloc(3*n_probe*sizeof(real));
+	ok=(cx!=NULL && ct!=NULL && cc!=NULL && r!=NULL && own!=NULL && probe_t!=NULL && probe_c!=NULL && probe_dx!=NULL);
+#if RP_NODE
+	ok=(PRF_GISUM1(!ok)==0);	//all nodes give up together
+#endif
+	if(!ok)
+	{
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("probe_setup: out of memory, %d probes not located\n",n_probe);
+		free(cx);
+		free(ct);
+		free(cc);
+		free(r);
+		free(own);
+		free(probe_t);
+		free(probe_c);
+		free(probe_dx);
+		probe_t=NULL;
+		probe_c=NULL;
+		probe_dx=NULL;
+		n_probe=0;
+		return;
+	}
+	k=0;
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop_int(c,t)
+		{
+			C_CENTROID(x,c,t);
+			cx[3*k]=x[0];
+			cx[3*k+1]=x[1];
+			cx[3*k+2]=x[2];
+			ct[k]=t;
+			cc[k]=c;
+			k++;
+		}
+		end_c_loop_int(c,t)
+	}
+	n_cell=k;
+	kd_build(&kd,cx,n_cell);
+
+	//r: -1 inside an own cell, else the distance to the closest own cell reached
+	for(j=0;j<n_probe;j++)
+	{
+		probe_t[j]=NULL;
+		r[j]=1e30;
+		if(n_cell==0) continue;
+		k=kd_nearest(&kd,&probe_x[3*j],NULL);
+		probe_t[j]=ct[k];
+		probe_c[j]=cc[k];
+		ok=probe_walk(&probe_x[3*j],&probe_c[j],&probe_t[j]);	//else the last cell reached
+		C_CENTROID(x,probe_c[j],probe_t[j]);
+		probe_dx[3*j]=probe_x[3*j]-x[0];
+		probe_dx[3*j+1]=probe_x[3*j+1]-x[1];
+		probe_dx[3*j+2]=probe_x[3*j+2]-x[2];
+		r[j]=ok?-1:NV_MAG(&probe_dx[3*j]);
+	}
+	for(j=0;j<n_probe;j++)
+	{
+		r[n_probe+j]=r[j];
+	}
+#if RP_NODE
+	work=r+n_probe;
+	PRF_GRLOW(r,n_probe,work);
+#endif
+	for(j=0;j<n_probe;j++)
+	{
+		own[j]=(probe_t[j]!=NULL && r[n_probe+j]==r[j])?myid:compute_node_count;
+	}
+#if RP_NODE
+	iwork=own+n_probe;
+	PRF_GILOW(own,n_probe,iwork);	//ties (a probe on a partition face): lowest node
+#endif
+	for(j=0;j<n_probe;j++)
+	{
+		outside+=(r[j]>=0);
+		if(own[j]!=myid)
+		{
+			probe_t[j]=NULL;	//sampled by another node
+		}
+	}
+	kd_free(&kd);
+	free(cx);
+	free(ct);
+	free(cc);
+	free(r);
+	free(own);
+	probe_stamp=udf_mesh_stamp(domain);
+#if RP_NODE
+	if(I_AM_NODE_ZERO_P)
+#endif
+	Message("probe_setup: %d probes located in %d cells, %d outside the fluid\n",n_probe,n_all,outside);
+#endif
+}
+
+/******************************probe sampling*****************************/
+
+static void probe_write(void)
+{
+	//owners fill their probes of a zero array, summed over the nodes and written by node 0
+#if !RP_HOST
+	Thread *t;
+	cell_t c;
+	real *d,*s;
+	real u,v,w,y;
+	int j,changed;
+#if RP_NODE
+	real *work;
+#endif
+
+	if(n_probe==0 || probe_t==NULL)
+	{
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("probe_sample: run probe_setup first\n");
+		return;
+	}
+	changed=(probe_stamp!=udf_mesh_stamp(Get_Domain(1)));
+#if RP_NODE
+	changed=PRF_GISUM1(changed);
+#endif
+	if(changed)
+	{
+		probe_setup();	//mesh adapted since the probes were located
+		if(n_probe==0 || probe_t==NULL) return;
+	}
+	s=(real *)calloc(4*n_probe,sizeof(real));
+	if(s==NULL)
+	{
+		Error("probe_sample: out of memory for %d probes\n",n_probe);
+		return;
+	}
+	for(j=0;j<n_probe;j++)
+	{
+		t=probe_t[j];
+		if(t==NULL) continue;
+		c=probe_c[j];
+		d=&probe_dx[3*j];
+		u=C_U(c,t);
+		v=C_V(c,t);
+		w=C_W(c,t);
+		y=C_YI(c,t,SPECIES);
+		if(NNULLP(THREAD_STORAGE(t,SV_U_G)) && NNULLP(THREAD_STORAGE(t,SV_V_G)) && NNULLP(THREAD_STORAGE(t,SV_W_G)))
+		{
+			u=u+NV_DOT(C_U_G(c,t),d);
+			v=v+NV_DOT(C_V_G(c,t),d);
+			w=w+NV_DOT(C_W_G(c,t),d);
+		}
+		if(NNULLP(THREAD_STORAGE(t,SV_Y_G)))
+		{
+			y=y+NV_DOT(C_YI_G(c,t,SPECIES),d);
+		}
+		s[4*j]=u;
+		s[4*j+1]=v;
+		s[4*j+2]=w;
+		s[4*j+3]=y;
+	}
+#if RP_NODE
+	work=(real *)malloc(4*n_probe*sizeof(real));
+	PRF_GRSUM(s,4*n_probe,work);
+	free(work);
+	if(I_AM_NODE_ZERO_P)
+#endif
+	{
+		FILE *fp=fopen(PROBE_OUT,"a");
+		if(fp!=NULL)
+		{
+			setvbuf(fp,NULL,_IOFBF,1<<20);	//one large write per buffer, not per probe
+			fprintf(fp,"# iteration %d time %g probes %d\n# x y z u v w |U| y\n",N_ITER,CURRENT_TIME,n_probe);
+			for(j=0;j<n_probe;j++)
+			{
+				u=s[4*j];
+				v=s[4*j+1];
+				w=s[4*j+2];
+				fprintf(fp,"%g %g %g %g %g %g %g %g\n",probe_x[3*j],probe_x[3*j+1],probe_x[3*j+2],u,v,w,sqrt(u*u+v*v+w*w),s[4*j+3]);
+			}
+			fclose(fp);
+		}
+	}
+	free(s);
+#endif
+}
+
+DEFINE_ON_DEMAND(probe_sample)
+{
+	probe_write();
+}
+
+DEFINE_EXECUTE_AT_END(probe_sample_end)
+{
+	int n=RP_Get_Boolean("rp-unsteady?")?N_TIME:N_ITER;
+
+	if(n%PROBE_EVERY!=0) return;
+	probe_write();
+}
@@ -0,0 +1,172 @@
+/**************************************************************************
+                     NO-NO2-O3 photostationary chemistry
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file adds the near-road NO-NO2-O3 cycle
+    NO2 + hv -> NO + O3      (J)
+    NO + O3 -> NO2 + O2      (k)
+to three species of the species transport model. The chemistry is split
+from transport: once per iteration/time step chem_adjust integrates the
+chemistry of all cells together over dt, and the species sources return
+the resulting mean rate. Since NOx=NO+NO2 and Ox=NO2+O3 are conserved by
+both reactions, [NO2] obeys the Riccati equation
+    d[NO2]/dt=k(NOx-[NO2])(Ox-[NO2])-J[NO2]=k([NO2]-a)([NO2]-b)
+whose exact solution is used, so the step is unconditionally stable for
+any dt however stiff the cycle is. The cells are gathered into plain
+arrays and integrated in one loop the compiler can vectorize. The rate
+and the analytic diagonal Jacobians are kept in C_UDMI(c,t,UDM_CHEM..+3)
+(N_UDM >= UDM_CHEM+4). The UDF file includes the following terms:
+1  batched chemistry step (chem_adjust);
+2  species sources of NO, NO2 and O3 (chem_no, chem_no2, chem_o3);
+**************************************************************************/
+
+#include "udf.h"
+
+#define SP_NO 0              //species index of NO
+#define SP_NO2 1             //species index of NO2
+#define SP_O3 2              //species index of O3
+#define MW_NO 30.006e-3      //molar masses (kg/mol)
+#define MW_NO2 46.006e-3
+#define MW_O3 47.998e-3
+#define T_AIR 298.15         //air temperature (K)
+#define J_NO2 8.0e-3         //NO2 photolysis frequency (1/s), 0 at night
+#define CHEM_DT 1.0          //chemistry step of steady runs (s)
+#define UDM_CHEM 11          //cell UDMs 11-14: rate of NO2 formation (mol/m3/s), dS of NO, NO2, O3 (kg/m3/s);
+                             //UDM_WC 0-3 of comfort, UDM_DECAY 4-6 & UDM_ADAPT 7 of the indices, UDM_DEP 8-10
+
+static int n_chem=0;
+static double *ch_nox=NULL;   //batched cell state (mol/m3)
+static double *ch_ox=NULL;
+static double *ch_x=NULL;     //[NO2] before and after the step
+static double *ch_rate=NULL;
+
+static double k_no_o3(void)
+{
+	//NO+O3 rate constant 1.4e-12*exp(-1310/T) cm3/molecule/s in m3/mol/s
+	return 1.4e-12*exp(-1310./T_AIR)*1e-6*6.02214076e23;
+}
+
+static void chem_step(int n,double k,double jp,double dt)
+{
+	//exact Riccati step of every cell; a<b are the roots, a the equilibrium
+	int i;
+
+	for(i=0;i<n;i++)
+	{
+		double nox=ch_nox[i],ox=ch_ox[i],x0=ch_x[i];
+		double bb=k*(nox+ox)+jp;
+		double s=sqrt(bb*bb-4*k*k*nox*ox);
+		double a=2*k*nox*ox/(bb+s+1e-300);		//cancellation-free small root
+		double b=(bb+s)/(2*k);
+		double q=(x0-a)/(x0-b)*exp(-s*dt);
+		double x=(s>0)?(a-b*q)/(1-q):x0;	//no NOx, no Ox and no light
+		ch_rate[i]=(x-x0)/dt;
+		ch_x[i]=x;
+	}
+}
+
+/****************************batched chemistry*****************************/
+
+DEFINE_ADJUST(chem_adjust,domain)
+{
+	Thread *t;
+	cell_t c;
+	double k,dt,no,no2,o3,rho;
+	int n,i;
+
+	if(N_UDM<UDM_CHEM+4 || n_spe<3)
+	{
+		return;
+	}
+	k=k_no_o3();
+	dt=RP_Get_Boolean("rp-unsteady?")?CURRENT_TIMESTEP:CHEM_DT;
+
+	n=0;
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		n+=THREAD_N_ELEMENTS_INT(t);
+	}
+	if(n>n_chem)
+	{
+		free(ch_nox); free(ch_ox); free(ch_x); free(ch_rate);
+		ch_nox=(double *)malloc(n*sizeof(double));
+		ch_ox=(double *)malloc(n*sizeof(double));
+		ch_x=(double *)malloc(n*sizeof(double));
+		ch_rate=(double *)malloc(n*sizeof(double));
+		n_chem=n;
+	}
+
+	i=0;
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop_int(c,t)
+		{
+			rho=C_R(c,t);
+			no=rho*MAX(C_YI(c,t,SP_NO),0)/MW_NO;
+			no2=rho*MAX(C_YI(c,t,SP_NO2),0)/MW_NO2;
+			o3=rho*MAX(C_YI(c,t,SP_O3),0)/MW_O3;
+			ch_nox[i]=no+no2;
+			ch_ox[i]=no2+o3;
+			ch_x[i]=no2;
+			i++;
+		}
+		end_c_loop_int(c,t)
+	}
+
+	chem_step(i,k,J_NO2,dt);
+
+	i=0;
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop_int(c,t)
+		{
+			rho=C_R(c,t);
+			no=ch_nox[i]-ch_x[i]+ch_rate[i]*dt;	//state at the start of the step
+			o3=ch_ox[i]-ch_x[i]+ch_rate[i]*dt;
+			C_UDMI(c,t,UDM_CHEM)=ch_rate[i];
+			C_UDMI(c,t,UDM_CHEM+1)=-rho*k*o3;		//d(S_NO)/d(Y_NO)
+			C_UDMI(c,t,UDM_CHEM+2)=-rho*J_NO2;		//d(S_NO2)/d(Y_NO2)
+			C_UDMI(c,t,UDM_CHEM+3)=-rho*k*no;		//d(S_O3)/d(Y_O3)
+			i++;
+		}
+		end_c_loop_int(c,t)
+	}
+}
+
+/*****************************species sources******************************/
+
+DEFINE_SOURCE(chem_no,c,t,dS,eqn)
+{
+	if(N_UDM<UDM_CHEM+4)
+	{
+		dS[eqn]=0;
+		return 0;
+	}
+	dS[eqn]=C_UDMI(c,t,UDM_CHEM+1);
+	return -MW_NO*C_UDMI(c,t,UDM_CHEM);
+}
+
+DEFINE_SOURCE(chem_no2,c,t,dS,eqn)
+{
+	if(N_UDM<UDM_CHEM+4)
+	{
+		dS[eqn]=0;
+		return 0;
+	}
+	dS[eqn]=C_UDMI(c,t,UDM_CHEM+2);
+	return MW_NO2*C_UDMI(c,t,UDM_CHEM);
+}
+
+DEFINE_SOURCE(chem_o3,c,t,dS,eqn)
+{
+	if(N_UDM<UDM_CHEM+4)
+	{
+		dS[eqn]=0;
+		return 0;
+	}
+	dS[eqn]=C_UDMI(c,t,UDM_CHEM+3);
+	return -MW_O3*C_UDMI(c,t,UDM_CHEM);
+}
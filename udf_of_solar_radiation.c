@@ -0,0 +1,557 @@
+/**************************************************************************
+                            solar radiation
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file sets the absorbed shortwave irradiance of ground and facades
+as a wall heat flux. Sun visibility of every wall face is found by casting
+a ray towards the sun against a bounding volume hierarchy (BVH) built once
+over all wall faces; the result is cached per solar hour as one bit per
+face and hour, so a 24-hour transient run traces every hour only once.
+Rays are traced in parallel when the UDF is compiled with OpenMP. The
+whole wall geometry has to be present in the process (serial or
+shared-memory runs). The same BVH gives the sky view factor (SVF) of every
+wall face by cosine-weighted hemisphere sampling; samples are drawn in
+batches until the standard error of the SVF falls below SVF_TOL, so open
+roofs and ground stop after SVF_MIN rays and only canyon faces need more.
+The SVF is stored in F_UDMI(f,t,UDM_SVF) for longwave/night-cooling
+boundary conditions and replaces the isotropic sky factor of the diffuse
+irradiance; after reading a case/data file it is taken back from this
+face UDM on first use. UDM_SVF is 1 because ground roughness keeps its
+pixel in face UDM 0 of the same wall faces (see the UDM table of the
+README). The UDF file includes the following terms:
+1  wall heat flux profile of absorbed shortwave radiation (solar_heat_flux);
+2  reset of the BVH and the visibility cache (solar_reset; adaption is detected by itself);
+3  sky view factor of all wall faces (svf_compute);
+**************************************************************************/
+
+#include "udf.h"
+#include "udf_mesh.h"
+
+#define LATITUDE 31.23       //site latitude (deg)
+#define DAY_OF_YEAR 196      //day of the simulated day (1-365)
+#define START_HOUR 6.0       //local solar time (h) at flow time 0
+#define DNI 800.             //direct normal irradiance (W/m2)
+#define DHI 100.             //diffuse horizontal irradiance (W/m2)
+#define ABS_SW 0.7           //shortwave absorptivity of the walls
+#define EAST 0               //axis pointing east
+#define NORTH 1              //axis pointing north
+#define UP 2                 //vertical axis
+#define RAY_EPS 1.e-3        //ray origin offset from the face (m)
+#define LEAF_TRIS 4          //triangles per BVH leaf
+#define BVH_STACK 128        //traversal stack; deeper trees are traced by brute force
+#define UDM_SVF 1            //face UDM of the sky view factor (0 is UDM_PIX of udf_of_ground_roughness.c)
+#define SVF_MIN 32           //rays per face before the error check
+#define SVF_MAX 1024         //rays per face at most
+#define SVF_TOL 0.01         //target standard error of the SVF
+
+typedef struct
+{
+	double lo[3],hi[3];
+	int next;                //second child (the first is node+1), or first triangle of a leaf
+	int count;               //0 for an inner node, triangles in the leaf otherwise
+} bvh_node;
+
+static int n_wall=0;                  //wall faces
+static int n_tri=0;
+static double *tri=NULL;              //9 doubles per triangle: v0, e1=v1-v0, e2=v2-v0
+static int *tri_id=NULL;              //triangle order of the BVH
+static bvh_node *bvh=NULL;
+static int n_node=0;
+static int bvh_depth=0;               //levels below the root
+static double *wall_x=NULL;           //3 per wall face: centroid
+static double *wall_n=NULL;           //3 per wall face: unit normal into the fluid
+static unsigned int *sun_mask=NULL;   //bit h: face sunlit during solar hour h
+static long long solar_stamp=UDF_MESH_UNKNOWN;	//mesh the wall faces were gathered on
+static unsigned int hours_done=0;     //bit h: hour h traced
+static double *wall_svf=NULL;         //sky view factor per wall face, NULL until computed
+static int svf_loaded=0;              //1: face UDM already checked for a stored SVF
+static Thread **wall_t=NULL;          //wall thread -> first face index
+static int *wall_off=NULL;
+static int n_wall_t=0;
+
+/**********************************BVH*************************************/
+
+static void tri_box(int k,double lo[3],double hi[3])
+{
+	const double *v=&tri[9*k];
+	int d;
+	for(d=0;d<3;d++)
+	{
+		double a=v[d],b=v[d]+v[3+d],c=v[d]+v[6+d];
+		lo[d]=(a<b?a:b)<c?(a<b?a:b):c;
+		hi[d]=(a>b?a:b)>c?(a>b?a:b):c;
+	}
+}
+
+static int bvh_build(int first,int count,int level)
+{
+	//median split of the triangle centroids along the longest box axis
+	int node=n_node++,d,ax,i,j,mid,tmp;
+	double lo[3],hi[3],clo[3],chi[3],c,pivot;
+
+	if(level>bvh_depth) bvh_depth=level;
+
+	bvh[node].lo[0]=bvh[node].lo[1]=bvh[node].lo[2]=1e30;
+	bvh[node].hi[0]=bvh[node].hi[1]=bvh[node].hi[2]=-1e30;
+	clo[0]=clo[1]=clo[2]=1e30;
+	chi[0]=chi[1]=chi[2]=-1e30;
+	for(i=first;i<first+count;i++)
+	{
+		tri_box(tri_id[i],lo,hi);
+		for(d=0;d<3;d++)
+		{
+			if(lo[d]<bvh[node].lo[d]) bvh[node].lo[d]=lo[d];
+			if(hi[d]>bvh[node].hi[d]) bvh[node].hi[d]=hi[d];
+			c=0.5*(lo[d]+hi[d]);
+			if(c<clo[d]) clo[d]=c;
+			if(c>chi[d]) chi[d]=c;
+		}
+	}
+	if(count<=LEAF_TRIS)
+	{
+		bvh[node].next=first;
+		bvh[node].count=count;
+		return node;
+	}
+	ax=0;
+	for(d=1;d<3;d++)
+	{
+		if(chi[d]-clo[d]>chi[ax]-clo[ax]) ax=d;
+	}
+	pivot=0.5*(clo[ax]+chi[ax]);
+	i=first;
+	j=first+count-1;
+	while(i<=j)
+	{
+		tri_box(tri_id[i],lo,hi);
+		if(0.5*(lo[ax]+hi[ax])<pivot)
+		{
+			i++;
+		}
+		else
+		{
+			tmp=tri_id[i]; tri_id[i]=tri_id[j]; tri_id[j]=tmp;
+			j--;
+		}
+	}
+	mid=i-first;
+	if(mid==0 || mid==count)
+	{
+		mid=count/2;	//all centroids coincide along ax
+	}
+	bvh[node].count=0;
+	bvh_build(first,mid,level+1);
+	bvh[node].next=bvh_build(first+mid,count-mid,level+1);	//first child is node+1
+	return node;
+}
+
+static int ray_box(const double o[3],const double inv[3],const bvh_node *b,double tmax)
+{
+	double t0=0,t1=tmax,ta,tb,tmp;
+	int d;
+	for(d=0;d<3;d++)
+	{
+		ta=(b->lo[d]-o[d])*inv[d];
+		tb=(b->hi[d]-o[d])*inv[d];
+		if(ta>tb)
+		{
+			tmp=ta; ta=tb; tb=tmp;
+		}
+		if(ta>t0) t0=ta;
+		if(tb<t1) t1=tb;
+		if(t0>t1) return 0;
+	}
+	return 1;
+}
+
+static int ray_tri(const double o[3],const double dir[3],const double *v,double tmax)
+{
+	//Moller-Trumbore; hit for 0<t<tmax
+	const double *e1=v+3,*e2=v+6;
+	double p[3],q[3],s[3],det,inv,u,w,t;
+
+	p[0]=dir[1]*e2[2]-dir[2]*e2[1];
+	p[1]=dir[2]*e2[0]-dir[0]*e2[2];
+	p[2]=dir[0]*e2[1]-dir[1]*e2[0];
+	det=e1[0]*p[0]+e1[1]*p[1]+e1[2]*p[2];
+	if(fabs(det)<1e-20) return 0;
+	inv=1/det;
+	s[0]=o[0]-v[0];
+	s[1]=o[1]-v[1];
+	s[2]=o[2]-v[2];
+	u=(s[0]*p[0]+s[1]*p[1]+s[2]*p[2])*inv;
+	if(u<0 || u>1) return 0;
+	q[0]=s[1]*e1[2]-s[2]*e1[1];
+	q[1]=s[2]*e1[0]-s[0]*e1[2];
+	q[2]=s[0]*e1[1]-s[1]*e1[0];
+	w=(dir[0]*q[0]+dir[1]*q[1]+dir[2]*q[2])*inv;
+	if(w<0 || u+w>1) return 0;
+	t=(e2[0]*q[0]+e2[1]*q[1]+e2[2]*q[2])*inv;
+	return t>0 && t<tmax;
+}
+
+static int ray_occluded(const double o[3],const double dir[3],double tmax)
+{
+	//any-hit traversal with an explicit stack; every level leaves at most one
+	//pending child, so depth+1 entries suffice, otherwise all triangles are tested
+	int stack[BVH_STACK],sp=0,node,i;
+	double inv[3];
+
+	if(bvh_depth>=BVH_STACK)
+	{
+		for(i=0;i<n_tri;i++)
+		{
+			if(ray_tri(o,dir,&tri[9*i],tmax)) return 1;
+		}
+		return 0;
+	}
+	inv[0]=1/dir[0];
+	inv[1]=1/dir[1];
+	inv[2]=1/dir[2];
+	stack[sp++]=0;
+	while(sp>0)
+	{
+		node=stack[--sp];
+		if(!ray_box(o,inv,&bvh[node],tmax)) continue;
+		if(bvh[node].count>0)
+		{
+			for(i=bvh[node].next;i<bvh[node].next+bvh[node].count;i++)
+			{
+				if(ray_tri(o,dir,&tri[9*tri_id[i]],tmax)) return 1;
+			}
+		}
+		else
+		{
+			stack[sp++]=bvh[node].next;
+			stack[sp++]=node+1;
+		}
+	}
+	return 0;
+}
+
+static void solar_free(void)
+{
+	free(tri); free(tri_id); free(bvh); free(wall_x); free(wall_n); free(sun_mask); free(wall_svf);
+	free(wall_t); free(wall_off);
+	tri=NULL; tri_id=NULL; bvh=NULL; wall_x=NULL; wall_n=NULL; sun_mask=NULL; wall_svf=NULL;
+	wall_t=NULL; wall_off=NULL;
+	n_wall=0; n_tri=0; n_node=0; n_wall_t=0; bvh_depth=0;
+	hours_done=0;
+	svf_loaded=0;
+}
+
+static void solar_setup(void)
+{
+	//gathers every wall face once: fan triangles for the BVH, centroid and normal
+	Domain *domain;
+	Thread *t;
+	face_t f;
+	Node *v;
+	real x[ND_ND];
+	real NV_VEC(A);
+	double a,v0[3];
+	int n,d,k=0,m=0;
+	domain=Get_Domain(1);
+
+	solar_free();
+	n=0;
+	thread_loop_f(t,domain)
+	{
+		n+=(THREAD_TYPE(t)==THREAD_F_WALL);
+	}
+	wall_t=(Thread **)malloc((n>0?n:1)*sizeof(Thread *));
+	wall_off=(int *)malloc((n>0?n:1)*sizeof(int));
+	thread_loop_f(t,domain)
+	{
+		if(THREAD_TYPE(t)!=THREAD_F_WALL) continue;
+		wall_t[n_wall_t]=t;
+		wall_off[n_wall_t++]=n_wall;
+		begin_f_loop(f,t)
+		{
+			n_wall++;
+			n_tri+=F_NNODES(f,t)-2;
+		}
+		end_f_loop(f,t)
+	}
+	tri=(double *)malloc(9*(n_tri>0?n_tri:1)*sizeof(double));
+	tri_id=(int *)malloc((n_tri>0?n_tri:1)*sizeof(int));
+	bvh=(bvh_node *)malloc(2*(n_tri>0?n_tri:1)*sizeof(bvh_node));
+	wall_x=(double *)malloc(3*(n_wall>0?n_wall:1)*sizeof(double));
+	wall_n=(double *)malloc(3*(n_wall>0?n_wall:1)*sizeof(double));
+	sun_mask=(unsigned int *)calloc(n_wall>0?n_wall:1,sizeof(unsigned int));
+
+	for(n=0;n<n_wall_t;n++)
+	{
+		t=wall_t[n];
+		begin_f_loop(f,t)
+		{
+			F_CENTROID(x,f,t);
+			F_AREA(A,f,t);
+			a=NV_MAG(A);
+			for(d=0;d<3;d++)
+			{
+				wall_x[3*k+d]=x[d];
+				wall_n[3*k+d]=-A[d]/a;	//boundary face areas point out of the fluid
+			}
+			k++;
+			f_node_loop(f,t,d)
+			{
+				v=F_NODE(f,t,d);
+				if(d==0)
+				{
+					v0[0]=NODE_X(v); v0[1]=NODE_Y(v); v0[2]=NODE_Z(v);
+				}
+				else if(d>=2)
+				{
+					Node *u=F_NODE(f,t,d-1);
+					tri[9*m]=v0[0]; tri[9*m+1]=v0[1]; tri[9*m+2]=v0[2];
+					tri[9*m+3]=NODE_X(u)-v0[0]; tri[9*m+4]=NODE_Y(u)-v0[1]; tri[9*m+5]=NODE_Z(u)-v0[2];
+					tri[9*m+6]=NODE_X(v)-v0[0]; tri[9*m+7]=NODE_Y(v)-v0[1]; tri[9*m+8]=NODE_Z(v)-v0[2];
+					tri_id[m]=m;
+					m++;
+				}
+			}
+		}
+		end_f_loop(f,t)
+	}
+	n_tri=m;
+	if(n_tri>0)
+	{
+		bvh_build(0,n_tri,0);
+	}
+	Message("solar_setup: %d wall faces, %d triangles, %d BVH nodes, depth %d\n",n_wall,n_tri,n_node,bvh_depth);
+	if(bvh_depth>=BVH_STACK)
+	{
+		Message("solar_setup: BVH deeper than %d levels, rays test all triangles (slow)\n",BVH_STACK);
+	}
+}
+
+/*****************************sun position*******************************/
+
+static void sun_vector(double hour,double s[3])
+{
+	//unit vector towards the sun for local solar time hour (h)
+	double phi=LATITUDE*M_PI/180.;
+	double dec=23.45*M_PI/180.*sin(2*M_PI*(284+DAY_OF_YEAR)/365.);
+	double w=(hour-12.)*15.*M_PI/180.;
+
+	s[EAST]=-cos(dec)*sin(w);
+	s[NORTH]=cos(phi)*sin(dec)-sin(phi)*cos(dec)*cos(w);
+	s[UP]=sin(phi)*sin(dec)+cos(phi)*cos(dec)*cos(w);
+}
+
+static void sun_trace(int h)
+{
+	//visibility of every wall face during solar hour h, sun at the mid-hour
+	double s[3];
+	unsigned int bit=1u<<h;
+	int k;
+
+	sun_vector(h+0.5,s);
+	if(s[UP]>0)
+	{
+#pragma omp parallel for schedule(dynamic,256)
+		for(k=0;k<n_wall;k++)
+		{
+			const double *n=&wall_n[3*k];
+			double o[3];
+			if(n[0]*s[0]+n[1]*s[1]+n[2]*s[2]<=0) continue;	//facing away from the sun
+			o[0]=wall_x[3*k]+RAY_EPS*n[0];
+			o[1]=wall_x[3*k+1]+RAY_EPS*n[1];
+			o[2]=wall_x[3*k+2]+RAY_EPS*n[2];
+			if(!ray_occluded(o,s,1e30)) sun_mask[k]|=bit;
+		}
+	}
+	hours_done|=bit;
+}
+
+/*****************************sky view factor*****************************/
+
+static double svf_face(int k,int *rays)
+{
+	//fraction of cosine-weighted rays from face k that escape to the sky
+	const double *n=&wall_n[3*k];
+	double a[3],b[3],o[3],dir[3],r,phi,c,len,p=0;
+	unsigned long long seed=0x9E3779B97F4A7C15ULL*(unsigned long long)(k+1);
+	int m=0,hit=0,d;
+
+	//orthonormal basis (a,b,n)
+	if(fabs(n[0])<0.9)
+	{
+		a[0]=0; a[1]=n[2]; a[2]=-n[1];
+	}
+	else
+	{
+		a[0]=-n[2]; a[1]=0; a[2]=n[0];
+	}
+	len=sqrt(a[0]*a[0]+a[1]*a[1]+a[2]*a[2]);
+	a[0]/=len; a[1]/=len; a[2]/=len;
+	b[0]=n[1]*a[2]-n[2]*a[1];
+	b[1]=n[2]*a[0]-n[0]*a[2];
+	b[2]=n[0]*a[1]-n[1]*a[0];
+	for(d=0;d<3;d++)
+	{
+		o[d]=wall_x[3*k+d]+RAY_EPS*n[d];
+	}
+
+	while(m<SVF_MAX)
+	{
+		//xorshift64*, one stream per face so the result does not depend on the thread count
+		seed^=seed>>12; seed^=seed<<25; seed^=seed>>27;
+		r=(double)((seed*0x2545F4914F6CDD1DULL)>>11)*(1./9007199254740992.);
+		seed^=seed>>12; seed^=seed<<25; seed^=seed>>27;
+		phi=2*M_PI*(double)((seed*0x2545F4914F6CDD1DULL)>>11)*(1./9007199254740992.);
+		c=sqrt(1-r);
+		r=sqrt(r);
+		for(d=0;d<3;d++)
+		{
+			dir[d]=r*cos(phi)*a[d]+r*sin(phi)*b[d]+c*n[d];
+		}
+		m++;
+		if(dir[UP]>0 && !ray_occluded(o,dir,1e30)) hit++;	//rays escaping below the horizon meet the ground
+		if(m>=SVF_MIN && m%SVF_MIN==0)
+		{
+			p=(double)hit/m;
+			if(p*(1-p)<SVF_TOL*SVF_TOL*m) break;
+		}
+	}
+	*rays=m;
+	return (double)hit/m;
+}
+
+static void solar_ensure(void)
+{
+	//wall faces, BVH and visibility of the current mesh: rebuilt after adaption
+	long long stamp=udf_mesh_stamp(Get_Domain(1));
+
+	if(sun_mask!=NULL && stamp==solar_stamp)
+	{
+		return;
+	}
+	solar_setup();
+	solar_stamp=stamp;
+}
+
+DEFINE_ON_DEMAND(svf_compute)
+{
+	face_t f;
+	Thread *t;
+	double mean=0;
+	long rays=0;
+	int k,n;
+
+	solar_ensure();
+	free(wall_svf);
+	wall_svf=(double *)malloc((n_wall>0?n_wall:1)*sizeof(double));
+#pragma omp parallel for schedule(dynamic,64) reduction(+:rays,mean)
+	for(k=0;k<n_wall;k++)
+	{
+		int m;
+		wall_svf[k]=svf_face(k,&m);
+		rays+=m;
+		mean+=wall_svf[k];
+	}
+	if(N_UDM>UDM_SVF)
+	{
+		for(n=0;n<n_wall_t;n++)
+		{
+			t=wall_t[n];
+			k=wall_off[n];
+			begin_f_loop(f,t)
+			{
+				F_UDMI(f,t,UDM_SVF)=wall_svf[k];
+				k++;
+			}
+			end_f_loop(f,t)
+		}
+	}
+	else
+	{
+		Message("svf_compute: %d user-defined memory location needed to store the SVF\n",UDM_SVF+1);
+	}
+	Message("svf_compute: %d wall faces, %ld rays, mean SVF %g\n",n_wall,rays,n_wall>0?mean/n_wall:0.);
+}
+
+static void svf_load(void)
+{
+	//takes the SVF of an earlier svf_compute back from the face UDM (e.g. after
+	//reading the data file); kept only if every value is a fraction and one is not 0
+	Thread *t;
+	face_t f;
+	double v;
+	int n,k,ok=1,any=0;
+
+	svf_loaded=1;
+	if(wall_svf!=NULL || N_UDM<=UDM_SVF || n_wall==0) return;
+	wall_svf=(double *)malloc(n_wall*sizeof(double));
+	if(wall_svf==NULL) return;
+	for(n=0;n<n_wall_t && ok;n++)
+	{
+		t=wall_t[n];
+		k=wall_off[n];
+		begin_f_loop(f,t)
+		{
+			v=F_UDMI(f,t,UDM_SVF);
+			ok=ok && v>=0 && v<=1;
+			any=any || v>0;
+			wall_svf[k++]=v;
+		}
+		end_f_loop(f,t)
+	}
+	if(!ok || !any)
+	{
+		free(wall_svf);
+		wall_svf=NULL;
+		return;
+	}
+	Message("solar_heat_flux: sky view factor of %d wall faces read from UDM %d\n",n_wall,UDM_SVF);
+}
+
+/************************solar wall heat flux*****************************/
+
+DEFINE_PROFILE(solar_heat_flux,t,i)
+{
+	face_t f;
+	double s[3],hour,cosi,sky;
+	int h,n,k;
+
+	solar_ensure();
+	if(!svf_loaded)
+	{
+		svf_load();
+	}
+	for(n=0;n<n_wall_t && wall_t[n]!=t;n++);
+	if(n==n_wall_t)
+	{
+		begin_f_loop(f,t)
+		{
+			F_PROFILE(f,t,i)=0;
+		}
+		end_f_loop(f,t)
+		return;
+	}
+
+	hour=fmod(START_HOUR+CURRENT_TIME/3600.,24.);
+	h=(int)hour;
+	if(!(hours_done&(1u<<h)))
+	{
+		sun_trace(h);
+	}
+	sun_vector(h+0.5,s);
+
+	k=wall_off[n];
+	begin_f_loop(f,t)
+	{
+		const double *nf=&wall_n[3*k];
+		cosi=nf[0]*s[0]+nf[1]*s[1]+nf[2]*s[2];
+		sky=(wall_svf!=NULL)?wall_svf[k]:0.5*(1+nf[UP]);	//isotropic sky of a tilted surface until the SVF is known
+		F_PROFILE(f,t,i)=(s[UP]>0)?ABS_SW*(((sun_mask[k]>>h)&1u)*DNI*cosi+DHI*sky):0;
+		k++;
+	}
+	end_f_loop(f,t)
+}
+
+DEFINE_ON_DEMAND(solar_reset)
+{
+	solar_free();
+}
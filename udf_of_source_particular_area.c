@@ -6,16 +6,24 @@
 This UDF file aims to setup a source term in a particular area in the 
 computational domain. The UDF file includes the following term:
 1  source term
+2  hot-path counters report & reset (only built with UDF_COUNTERS)
 **************************************************************************/
 
 #include "udf.h"
 #include "prop.h"
+#include "udf_counters.h"
+
+enum {CNT_UDF_SOURCE};
+#ifdef UDF_COUNTERS
+UDF_COUNTERS_TABLE {{"udf_source"}};
+#endif
 
 /******************************source term********************************/
 DEFINE_SOURCE(udf_source, c, t, dS, eqn)
 {
 	real x[ND_ND];
 	real con,source;
+	UDF_COUNTER_BEGIN;
 
 	C_CENTROID(x,c,t);
        
@@ -29,5 +37,20 @@ DEFINE_SOURCE(udf_source, c, t, dS, eqn)
 	}
 
 	dS[eqn]=0;
+	UDF_COUNTER_END(CNT_UDF_SOURCE,1);
 	return source;
 }
+
+/**************************hot-path counters****************************/
+
+#ifdef UDF_COUNTERS
+DEFINE_ON_DEMAND(source_counters_report)
+{
+	UDF_COUNTERS_REPORT("counters_source.txt")
+}
+
+DEFINE_ON_DEMAND(source_counters_reset)
+{
+	UDF_COUNTERS_RESET()
+}
+#endif
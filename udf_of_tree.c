@@ -13,9 +13,13 @@ including the following terms:
 6  profile term of inlet velocity
 7  profile term of inlet k
 8  profile term of inlet e
+9  hot-path counters report & reset (only built with UDF_COUNTERS)
+10 fast math switch & check (tree_fastmath_on/off/check)
 **************************************************************************/
 
 #include "udf.h"
+#include "udf_counters.h"
+#include "udf_fastmath.h"
 #define W(U,V,W) (sqrt((U)*(U)+(V)*(V)+(W)*(W)))   //average velocity
 #define Cdf 0.2
 #define H 1.0
@@ -29,31 +33,46 @@ including the following terms:
 #define L 25.0
 #define V 1.5e-5
 
+enum {CNT_X_MOMENTUM_SOURCE,CNT_Y_MOMENTUM_SOURCE,CNT_Z_MOMENTUM_SOURCE,CNT_K_SOURCE,CNT_E_SOURCE,CNT_VELOCITY_PROFILE,CNT_K_PROFILE,CNT_E_PROFILE};
+#ifdef UDF_COUNTERS
+UDF_COUNTERS_TABLE {{"x_momentum_source"},{"y_momentum_source"},{"z_momentum_source"},{"k_source"},{"e_source"},{"velocity_profile"},{"k_profile"},{"e_profile"}};
+#endif
+
+/***************************leaf area density*****************************/
+static real lad_of(real y)
+{
+	//r^6 and r^0.5 are formed without pow(); exp() goes through udf_fastmath.h
+	real r,r2;
+
+	if(y<Zm && y>=0)
+	{
+		r=(H-Zm)/(H-y);
+		r2=r*r;
+		return Lm*r2*r2*r2*UDF_FAST_EXP(6*(1-r));
+	}
+	else if(y>=Zm && y<H)
+	{
+		r=(H-Zm)/(H-y);
+		return Lm*sqrt(r)*UDF_FAST_EXP(0.5*(1-r));
+	}
+	return 0;
+}
+
 /***********************source term of X momentum**************************/
 DEFINE_SOURCE(x_momentum_source,c,t,dS,eqn)
 {
 	real x[ND_ND];
-	real source,lad,n;
+	real source,lad,w;
+	UDF_COUNTER_BEGIN;
 
 	C_CENTROID(x,c,t);
 
-	if(x[1]<Zm && x[1]>=0)
-	{
-		n=6;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else if(x[1]>=Zm && x[1]<H)
-	{
-		n=0.5;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else
-	{
-		lad=0;
-	}
+	lad=lad_of(x[1]);
+	w=W(C_U(c,t),C_V(c,t),C_W(c,t));
 
-	source=-Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t))*C_U(c,t);
-	dS[eqn]=-Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t));
+	source=-Cdf*lad*w*C_U(c,t);
+	dS[eqn]=-Cdf*lad*w;
+	UDF_COUNTER_END(CNT_X_MOMENTUM_SOURCE,1);
 	return source;
 }
 
@@ -61,27 +80,17 @@ DEFINE_SOURCE(x_momentum_source,c,t,dS,eqn)
 DEFINE_SOURCE(y_momentum_source,c,t,dS,eqn)
 {
 	real x[ND_ND];
-	real source,lad,n;
+	real source,lad,w;
+	UDF_COUNTER_BEGIN;
 
 	C_CENTROID(x,c,t);
 
-	if(x[1]<Zm && x[1]>=0)
-	{
-		n=6;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else if(x[1]>=Zm && x[1]<H)
-	{
-		n=0.5;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else
-	{
-		lad=0;
-	}
+	lad=lad_of(x[1]);
+	w=W(C_U(c,t),C_V(c,t),C_W(c,t));
 
-	source=-Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t))*C_V(c,t);
-	dS[eqn]=-Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t));
+	source=-Cdf*lad*w*C_V(c,t);
+	dS[eqn]=-Cdf*lad*w;
+	UDF_COUNTER_END(CNT_Y_MOMENTUM_SOURCE,1);
 	return source;
 }
 
@@ -89,27 +98,17 @@ DEFINE_SOURCE(y_momentum_source,c,t,dS,eqn)
 DEFINE_SOURCE(z_momentum_source,c,t,dS,eqn)
 {
 	real x[ND_ND];
-	real source,lad,n;
+	real source,lad,w;
+	UDF_COUNTER_BEGIN;
 
 	C_CENTROID(x,c,t);
 
-	if(x[1]<Zm && x[1]>=0)
-	{
-		n=6;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else if(x[1]>=Zm && x[1]<H)
-	{
-		n=0.5;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else
-	{
-		lad=0;
-	}
+	lad=lad_of(x[1]);
+	w=W(C_U(c,t),C_V(c,t),C_W(c,t));
 
-	source=-Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t))*C_W(c,t);
-	dS[eqn]=-Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t));
+	source=-Cdf*lad*w*C_W(c,t);
+	dS[eqn]=-Cdf*lad*w;
+	UDF_COUNTER_END(CNT_Z_MOMENTUM_SOURCE,1);
 	return source;
 }
 
@@ -117,27 +116,17 @@ DEFINE_SOURCE(z_momentum_source,c,t,dS,eqn)
 DEFINE_SOURCE(k_source,c,t,dS,eqn)
 {
 	real x[ND_ND];
-	real source,lad,n;
+	real source,lad,w;
+	UDF_COUNTER_BEGIN;
 
 	C_CENTROID(x,c,t);
 
-	if(x[1]<Zm && x[1]>=0)
-	{
-		n=6;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else if(x[1]>=Zm && x[1]<H)
-	{
-		n=0.5;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else
-	{
-		lad=0;
-	}
+	lad=lad_of(x[1]);
+	w=W(C_U(c,t),C_V(c,t),C_W(c,t));
 
-	source=Cdf*lad*pow(W(C_U(c,t),C_V(c,t),C_W(c,t)),3)-4*Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t))*C_K(c,t);
-	dS[eqn]=-4*Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t));
+	source=Cdf*lad*w*w*w-4*Cdf*lad*w*C_K(c,t);
+	dS[eqn]=-4*Cdf*lad*w;
+	UDF_COUNTER_END(CNT_K_SOURCE,1);
 	return source;
 }
 
@@ -145,27 +134,17 @@ DEFINE_SOURCE(k_source,c,t,dS,eqn)
 DEFINE_SOURCE(e_source,c,t,dS,eqn)
 {
 	real x[ND_ND];
-	real source,lad,n;
+	real source,lad,w;
+	UDF_COUNTER_BEGIN;
 
 	C_CENTROID(x,c,t);
 
-	if(x[1]<Zm && x[1]>=0)
-	{
-		n=6;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else if(x[1]>=Zm && x[1]<H)
-	{
-		n=0.5;
-		lad=Lm*pow(((H-Zm)/(H-x[1])),n)*exp(n*(1-((H-Zm)/(H-x[1]))));
-	}
-	else
-	{
-		lad=0;
-	}
+	lad=lad_of(x[1]);
+	w=W(C_U(c,t),C_V(c,t),C_W(c,t));
 
-	source=1.5*Cdf*lad*pow(W(C_U(c,t),C_V(c,t),C_W(c,t)),3)-6*Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t))*C_D(c,t);
-	dS[eqn]=-6*Cdf*lad*W(C_U(c,t),C_V(c,t),C_W(c,t));
+	source=1.5*Cdf*lad*w*w*w-6*Cdf*lad*w*C_D(c,t);
+	dS[eqn]=-6*Cdf*lad*w;
+	UDF_COUNTER_END(CNT_E_SOURCE,1);
 	return source;
 }
 
@@ -177,6 +156,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
 	real ufree=6;
 	real del=10;
 	face_t f;
+	UDF_COUNTER_BEGIN;
 
 	begin_f_loop(f,t)
 	{
@@ -185,7 +165,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
       
 		if(h<=del)
         	{
-			F_PROFILE(f,t,i)=ufree*pow(h/del,B);
+			F_PROFILE(f,t,i)=ufree*UDF_FAST_POW(h/del,B);
         	}
         	else
         	{
@@ -194,6 +174,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_VELOCITY_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /************************profile term of inlet k***************************/
@@ -204,9 +185,10 @@ DEFINE_PROFILE(k_profile,t,i)
 	real Re,ff,utau;
 	real ufree=6;
 	face_t f;
+	UDF_COUNTER_BEGIN;
   
 	Re=(ufree*L)/V;
-	ff=0.074/(pow(Re,0.2));
+	ff=0.074/(UDF_FAST_POW(Re,0.2));
 	utau=sqrt(ff*ufree*ufree*0.5);
 
 	begin_f_loop(f,t)
@@ -216,7 +198,7 @@ DEFINE_PROFILE(k_profile,t,i)
       
 		if(h<=WW)
         	{
-			F_PROFILE(f,t,i)=(pow(utau,2)*pow((1-h/WW),2))/(sqrt(Cmu));
+			F_PROFILE(f,t,i)=(utau*utau*(1-h/WW)*(1-h/WW))/(sqrt(Cmu));
         	}
         	else
         	{
@@ -225,6 +207,7 @@ DEFINE_PROFILE(k_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_K_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /************************profile term of inlet e***************************/
@@ -235,9 +218,10 @@ DEFINE_PROFILE(e_profile,t,i)
 	real Re,ff,utau;
 	real ufree=6;
 	face_t f;
+	UDF_COUNTER_BEGIN;
   
 	Re=(ufree*L)/V;
-	ff=0.074/(pow(Re,0.2));
+	ff=0.074/(UDF_FAST_POW(Re,0.2));
 	utau=sqrt(ff*ufree*ufree*0.5);
 
 	begin_f_loop(f,t)
@@ -247,7 +231,7 @@ DEFINE_PROFILE(e_profile,t,i)
       
 		if(h<=WW)
         	{
-			F_PROFILE(f,t,i)=((pow(utau,3)*pow((1-h/WW),2))/(KAR*(h+Z0)))*(1+5.75*(h/Z0));
+			F_PROFILE(f,t,i)=((utau*utau*utau*(1-h/WW)*(1-h/WW))/(KAR*(h+Z0)))*(1+5.75*(h/Z0));
         	}
         	else
         	{
@@ -256,4 +240,36 @@ DEFINE_PROFILE(e_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_E_PROFILE,THREAD_N_ELEMENTS_INT(t));
+}
+
+/**************************hot-path counters****************************/
+
+#ifdef UDF_COUNTERS
+DEFINE_ON_DEMAND(tree_counters_report)
+{
+	UDF_COUNTERS_REPORT("counters_tree.txt")
+}
+
+DEFINE_ON_DEMAND(tree_counters_reset)
+{
+	UDF_COUNTERS_RESET()
+}
+#endif
+
+/***************************fast math switch******************************/
+
+DEFINE_ON_DEMAND(tree_fastmath_on)
+{
+	udf_fast_math=1;
+}
+
+DEFINE_ON_DEMAND(tree_fastmath_off)
+{
+	udf_fast_math=0;
+}
+
+DEFINE_ON_DEMAND(tree_fastmath_check)
+{
+	fastmath_sweep();
 }
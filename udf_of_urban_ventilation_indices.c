@@ -9,7 +9,7 @@ following terms:
 2  Profile term of inlet k;
 3  Profile term of inlet e;
 4  Pollutant source term;
-5  Volume of target volume;
+5  Geometry of target volume (vol, Ap & a_roof), computed once;
 6  Purging flow rate (PFR) term;
 7  Local mean age of air (LMAA) term;
 8  Mean residence time (Tau_R) term;
@@ -21,12 +21,26 @@ following terms:
 14 Air exchange efficiency (Ea) term;
 15 Net escape velocity (NEV) term;
 16 Pollutant transport rates across street openings (FAm* & FAt*) term;
-17 Spatial average pollutant concentration (C_canopy) term;
+17 Spatial average, 95th/99th percentiles & exceedance fractions of pollutant concentration (C_canopy) term;
 18 Exchange velocity (U_E) term;
+19 Face geometry of all DOI openings (FA_setup) term;
+20 Mean & turbulent fluxes across all DOI openings (FA*) term;
+21 Binary snapshot export (umc_snapshot.h) term;
+22 Hot-path counters report & reset (only built with UDF_COUNTERS);
+23 Remapping weights from cells to a regular raster (raster_setup) term;
+24 Raster export of |U|, local age of air & concentration term;
+25 Fast math switch & check (indices_fastmath_on/off/check);
+26 Geometry reset & read/write with the case/data file (geo_reset_udf, geo_write, geo_read);
+27 Tracer-decay (puff) method of the local age of air (decay_accumulate & decay_result_udf);
+28 Refinement marking from velocity & concentration gradients around the DOI (adapt_mark);
 **************************************************************************/
 
 #include "udf.h"
 #include "sg.h"
+#include "umc_snapshot.h"
+#include "udf_counters.h"
+#include "udf_fastmath.h"
+#include "udf_mesh.h"
 
 #define UH 7.84            //reference velocity (m/s)
 #define H 18.              //height of buildings (m)
@@ -37,14 +51,52 @@ following terms:
 #define Cmu 0.09
 #define M 0.00001          //pollutant emmision rate (kg/m3*s)
 #define RHO 1.29           //density of air (kg/m3)
-#define Sct 0.7;
+#define Sct 0.7
 
-#define XA 0.0;	//coordinate of target volume
-#define XB 4.0;
-#define YA 0.0;
-#define YB 5.0;
-#define ZA 0.0;
-#define ZB 3.0;
+#define XA 0.0	//coordinate of target volume
+#define XB 4.0
+#define YA 0.0
+#define YB 5.0
+#define ZA 0.0
+#define ZB 3.0
+
+#define EXPORT_ROI 0        //1: export only the region below (plus one halo cell layer)
+#define EXPORT_XMIN XA      //region of interest of the snapshot export
+#define EXPORT_XMAX XB
+#define EXPORT_YMIN YA
+#define EXPORT_YMAX YB
+#define EXPORT_ZMIN ZA
+#define EXPORT_ZMAX ZB
+#define EXPORT_EVERY 100    //export_snapshot_end writes every EXPORT_EVERY iterations/time steps
+
+#define RASTER_X0 -50.      //lower-left corner of the output raster (model coordinates, m)
+#define RASTER_Y0 -50.
+#define RASTER_Z0 1.0       //bottom of the first layer; NZ=1 & DZ=1 gives the 1-2 m pedestrian layer
+#define RASTER_DX 1.0       //pixel size (m)
+#define RASTER_DZ 1.0       //layer thickness (m)
+#define RASTER_NX 100
+#define RASTER_NY 100
+#define RASTER_NZ 1
+#define GEO_X0 0.           //map coordinates (e.g. UTM easting/northing) of the model origin
+#define GEO_Y0 0.
+
+#define DECAY_MODE 0        //1: Pullation_1 is switched off at DECAY_T0 (transient tracer-decay method)
+#define DECAY_T0 600.       //flow time of the switch-off (s)
+#define DECAY_STOP 0.001    //moments stop once the DOI tracer mass falls below this fraction of that at DECAY_T0
+#define HIST_SUB 3          //2^HIST_SUB equal buckets per octave of concentration (at most 12.5% relative width)
+#define HIST_EMIN -40       //concentration histogram range 2^HIST_EMIN..2^HIST_EMAX (mass fraction)
+#define HIST_EMAX 0
+#define HIST_N ((((HIST_EMAX)-(HIST_EMIN))<<HIST_SUB)+2)	//plus one under- and one overflow bucket
+#define N_CTHR 2            //number of exceedance thresholds
+
+#define ADAPT_BUFFER 2.0    //marking region: DOI box grown by this distance (m), up to ZB+ADAPT_BUFFER over the roof opening
+#define ADAPT_REFINE 0.3    //refine where an indicator exceeds this fraction of its maximum in the region
+#define ADAPT_COARSEN 0.03  //coarsen where both indicators are below this fraction
+#define ADAPT_EVERY 50      //adapt_mark updates the marks every ADAPT_EVERY iterations/time steps
+#define UDM_ADAPT 7         //cell UDM 7 of the marks: +1 refine, -1 coarsen, 0 keep (after UDM_DECAY 4-6)
+
+#define UDM_DECAY 4         //cell UDMs 4-6: int C dt, int (t-t0)C dt, C at t0 (N_UDM >= UDM_DECAY+3);
+                            //UDM_WC 0-3 of comfort, UDM_DEP 8-10, UDM_CHEM 11-14
 
 real PFR;    //define global variables
 real vol;
@@ -59,6 +111,28 @@ real FAm_in,FAm_out,FAt;
 real a_roof;
 real C_canopy;
 real U_E;
+real FA_in[5],FA_out[5],FA_tur[5];	//per opening: XA, XB, YA, YB (sides) and ZB (roof)
+real a_side[5];
+real C_p95,C_p99;	//volume-weighted percentiles of concentration in the DOI
+real C_exceed[N_CTHR];	//volume fraction of the DOI above c_thr
+static const real c_thr[N_CTHR]={1e-5,1e-4};	//exceedance thresholds (mass fraction)
+static int geo_valid=0;	//vol, Ap & a_roof computed...
+static long long geo_stamp=UDF_MESH_UNKNOWN;	//...on the mesh of this stamp (udf_mesh.h)
+
+enum {CNT_VELOCITY_PROFILE,CNT_K_PROFILE,CNT_E_PROFILE,CNT_PULLATION_1,CNT_VOL_UDF,CNT_PFR_1_UDF,CNT_LMAA_1_UDF,CNT_TAU_R_1_UDF,CNT_VF_1_UDF,CNT_TP_1_UDF,CNT_Q_1_UDF,CNT_TAU_N_1_UDF,CNT_ACH_1_UDF,CNT_EA_1_UDF,CNT_NEV_UDF,CNT_FA_ROOF_UDF,CNT_YCANOPY_UDF,CNT_U_E_UDF,CNT_FA_SETUP_UDF,CNT_FA_UDF,CNT_EXPORT_SNAPSHOT_UDF};
+#ifdef UDF_COUNTERS
+UDF_COUNTERS_TABLE {{"velocity_profile"},{"k_profile"},{"e_profile"},{"Pullation_1"},{"vol_udf"},{"PFR_1_udf"},{"LMAA_1_udf"},{"Tau_R_1_udf"},{"VF_1_udf"},{"TP_1_udf"},{"Q_1_udf"},{"Tau_N_1_udf"},{"ACH_1_udf"},{"Ea_1_udf"},{"NEV_udf"},{"FA_roof_udf"},{"yCanopy_udf"},{"U_E_udf"},{"FA_setup_udf"},{"FA_udf"},{"export_snapshot_udf"}};
+#endif
+
+/* face geometry of the DOI openings in structure-of-arrays layout, filled by FA_setup_udf */
+static int fa_n=0;
+static int *fa_side=NULL;
+static cell_t *fa_c0=NULL,*fa_c1=NULL;
+static Thread **fa_t0=NULL,**fa_t1=NULL;
+static real *fa_ax=NULL,*fa_ay=NULL,*fa_az=NULL;	//area vector pointing out of the DOI
+static real *fa_w0=NULL;	//interpolation weight of c0 (c1 gets 1-w0)
+static real *fa_g=NULL;		//(A.d)/(d.d) with d=x1-x0, so that grad(phi).A=(phi1-phi0)*fa_g
+static long long fa_stamp=UDF_MESH_UNKNOWN;	//mesh of the arrays
 
 /**********************Profile term of inlet velocity**********************/
 
@@ -67,6 +141,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
 	real x[ND_ND];
 	real h;
 	face_t f;
+	UDF_COUNTER_BEGIN;
 
 	begin_f_loop(f,t)
 	{
@@ -75,7 +150,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
       
 		if(h<=DELTA && h>=0)
 		{
-			F_PROFILE(f,t,i)=UH*pow(h/DELTA,ALPHA);
+			F_PROFILE(f,t,i)=UH*UDF_FAST_POW(h/DELTA,ALPHA);
 		}
 		else
 		{
@@ -83,6 +158,7 @@ DEFINE_PROFILE(velocity_profile,t,i)
 		}
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_VELOCITY_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /************************Profile term of inlet k**************************/
@@ -92,6 +168,7 @@ DEFINE_PROFILE(k_profile,t,i)
 	real x[ND_ND];
 	real h;
 	face_t f;
+	UDF_COUNTER_BEGIN;
   
 	begin_f_loop(f,t)
 	{
@@ -109,6 +186,7 @@ DEFINE_PROFILE(k_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_K_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /************************Profile term of inlet e**************************/
@@ -118,6 +196,7 @@ DEFINE_PROFILE(e_profile,t,i)
 	real x[ND_ND];
 	real h;
 	face_t f;
+	UDF_COUNTER_BEGIN;
   
 	begin_f_loop(f,t)
 	{
@@ -135,6 +214,7 @@ DEFINE_PROFILE(e_profile,t,i)
 
 	}
 	end_f_loop(f,t)
+	UDF_COUNTER_END(CNT_E_PROFILE,THREAD_N_ELEMENTS_INT(t));
 }
 
 /*************************Pollutant source term**************************/
@@ -143,6 +223,7 @@ DEFINE_SOURCE(Pullation_1,c,t,dS,eqn)
 {
 	real x[ND_ND];
 	real source;
+	UDF_COUNTER_BEGIN;
 	C_CENTROID(x,c,t);
 	
 	if(x[0]>=XA && x[0]<=XB && x[1]>=YA && x[1]<=YB && x[2]>=ZA && x[2]<=ZB)
@@ -153,26 +234,37 @@ DEFINE_SOURCE(Pullation_1,c,t,dS,eqn)
 	{
 		source = 0;
 	}
+	if(DECAY_MODE && CURRENT_TIME>DECAY_T0)
+	{
+		source = 0;	//tracer decay: no emission after t0
+	}
 	
 	dS[eqn]=0;
+	UDF_COUNTER_END(CNT_PULLATION_1,1);
 	return source;
 }
 
 /************************volume of target volume*************************/
 
-DEFINE_ON_DEMAND(vol_udf)
+static void geo_compute(void)
 {
+	//vol, Ap & a_roof in one sweep, with the same tests as VF_1_udf and FA_roof_udf
 	Domain *domain;
 	Thread *t;
 	cell_t c;
+	face_t f;
 	real x[ND_ND];
-	FILE *fp_vol;
-	fp_vol=fopen("vol.txt","a");
+	real NV_VEC(A);
+	real a;
+	real xx,yy,zz;
 	domain=Get_Domain(1);
-	
+
+	vol=0;
+	Ap=0;
+	a_roof=0;
 	thread_loop_c(t,domain)
 	{
-		begin_c_loop(c,t)
+		begin_c_loop_int(c,t)
 		{
 			C_CENTROID(x,c,t);
 			if(x[0]>=XA && x[0]<=XB && x[1]>=YA && x[1]<=YB && x[2]>=ZA && x[2]<=ZB)
@@ -180,10 +272,66 @@ DEFINE_ON_DEMAND(vol_udf)
 				vol=vol+C_VOLUME(c,t);
 			}
 		}
-		end_c_loop(c,t)
+		end_c_loop_int(c,t)
+	}
+	thread_loop_f(t,domain)
+	{
+		if(BOUNDARY_FACE_THREAD_P(t)) continue;
+		begin_f_loop(f,t)
+		{
+			if(!PRINCIPAL_FACE_P(f,t)) continue;	//partition-boundary faces once
+			F_AREA(A,f,t);
+			a=NV_MAG(A);
+			F_CENTROID(x,f,t);
+			xx=ROUND(x[0]*10.0)/10.0;
+			yy=ROUND(x[1]*10.0)/10.0;
+			zz=ROUND(x[2]*10.0)/10.0;
+			if(xx==XA && yy>=YA && yy<=YB && zz>=ZA && zz<=ZB) Ap=Ap+a;
+			if(xx==XB && yy>=YA && yy<=YB && zz>=ZA && zz<=ZB) Ap=Ap+a;
+			if(xx>=XA && xx<=XB && yy==YA && zz>=ZA && zz<=ZB) Ap=Ap+a;
+			if(xx>=XA && xx<=XB && yy==YB && zz>=ZA && zz<=ZB) Ap=Ap+a;
+			if(xx>=XA && xx<=XB && yy>=YA && yy<=YB && zz==ZB) Ap=Ap+a;
+			xx=ROUND(x[0]*100.0)/100.0;
+			yy=ROUND(x[1]*100.0)/100.0;
+			zz=ROUND(x[2]*100.0)/100.0;
+			if(xx>=XA && xx<=XB && yy>=YA && yy<=YB && zz==ZB) a_roof=a_roof+a;
+		}
+		end_f_loop(f,t)
 	}
+#if RP_NODE
+	vol=PRF_GRSUM1(vol);
+	Ap=PRF_GRSUM1(Ap);
+	a_roof=PRF_GRSUM1(a_roof);
+#endif
+	geo_valid=1;
+	geo_stamp=udf_mesh_stamp(domain);
+}
+
+static void geo_ensure(void)
+{
+	//recomputes after geo_reset_udf and whenever the mesh was adapted or replaced
+	long long stamp=udf_mesh_stamp(Get_Domain(1));
+
+	if(geo_valid && geo_stamp==UDF_MESH_UNKNOWN)
+	{
+		geo_stamp=stamp;	//restored by geo_read for the mesh just read
+	}
+	if(!geo_valid || geo_stamp!=stamp)
+	{
+		geo_compute();
+	}
+}
+
+DEFINE_ON_DEMAND(vol_udf)
+{
+	FILE *fp_vol;
+	UDF_COUNTER_BEGIN;
+	fp_vol=fopen("vol.txt","a");
+	
+	geo_compute();	//recomputed, not accumulated, however often it is called
 	fprintf(fp_vol,"%g\n",vol);
 	fclose(fp_vol);
+	UDF_COUNTER_END(CNT_VOL_UDF,udf_domain_cells(Get_Domain(1)));
 }
 
 /*******************************PFR term********************************/
@@ -197,7 +345,9 @@ DEFINE_ON_DEMAND(PFR_1_udf)
 	real cpt=0;
 	real cpa;
 	FILE *fp_pfr;
+	UDF_COUNTER_BEGIN;
 	fp_pfr=fopen("PFR.txt","a");
+	geo_ensure();
 	domain=Get_Domain(1);
 	
 	thread_loop_c(t,domain)
@@ -216,6 +366,7 @@ DEFINE_ON_DEMAND(PFR_1_udf)
 	PFR=(M*vol)/(cpa*RHO);
 	fprintf(fp_pfr,"%g\n",PFR);
 	fclose(fp_pfr);
+	UDF_COUNTER_END(CNT_PFR_1_UDF,udf_domain_cells(domain));
 }
 
 /*******************************LMAA term********************************/
@@ -229,7 +380,9 @@ DEFINE_ON_DEMAND(LMAA_1_udf)
 	real cpt=0;
 	real cpa;
 	FILE *fp_lmaa;
+	UDF_COUNTER_BEGIN;
 	fp_lmaa=fopen("LMAA.txt","a");
+	geo_ensure();
 	domain=Get_Domain(1);
 	
 	thread_loop_c(t,domain)
@@ -248,6 +401,7 @@ DEFINE_ON_DEMAND(LMAA_1_udf)
 	LMAA=cpa/M;
 	fprintf(fp_lmaa,"%g\n",LMAA);
 	fclose(fp_lmaa);
+	UDF_COUNTER_END(CNT_LMAA_1_UDF,udf_domain_cells(domain));
 }
 
 /*****************************Tau_R term******************************/
@@ -255,12 +409,14 @@ DEFINE_ON_DEMAND(LMAA_1_udf)
 DEFINE_ON_DEMAND(Tau_R_1_udf)
 {
 	FILE *fp_tau_r;
+	UDF_COUNTER_BEGIN;
 	fp_tau_r=fopen("Tau_R.txt","a");
 	
 	Tau_R=2*LMAA;
 
 	fprintf(fp_tau_r,"%g\n",Tau_R);
 	fclose(fp_tau_r);
+	UDF_COUNTER_END(CNT_TAU_R_1_UDF,0);
 }
 
 /*******************************VF term********************************/
@@ -272,7 +428,7 @@ DEFINE_ON_DEMAND(VF_1_udf)
 	face_t f;
 	Thread *t0,*t1=NULL;
 	cell_t c0,c1=-1;
-	real delta_qp,qp;
+	real delta_qp=0,qp;
 	real x[ND_ND];
 	real NV_VEC(A);
 	real a;
@@ -282,7 +438,9 @@ DEFINE_ON_DEMAND(VF_1_udf)
 	real xxx,yyy,zzz;
 	real xx,yy,zz;
 	FILE *fp_vf;
+	UDF_COUNTER_BEGIN;
 	fp_vf=fopen("VF.txt","a");
+	geo_ensure();
 	domain=Get_Domain(1);
 	
 	thread_loop_f(t,domain)
@@ -325,7 +483,6 @@ DEFINE_ON_DEMAND(VF_1_udf)
 					u=(C_U(c0,t0)+C_U(c1,t1))/2;
 					y=(C_YI(c0,t0,0)+C_YI(c1,t1,0))/2;
 					rho=(C_R(c0,t0)+C_R(c1,t1))/2;
-					Ap=Ap+a;
 				}
 				delta_qp=delta_qp+rho*a*((fabs(u)+u)/2)*y;
 			}
@@ -353,7 +510,6 @@ DEFINE_ON_DEMAND(VF_1_udf)
 					u=(C_U(c0,t0)+C_U(c1,t1))/2;
 					y=(C_YI(c0,t0,0)+C_YI(c1,t1,0))/2;
 					rho=(C_R(c0,t0)+C_R(c1,t1))/2;
-					Ap=Ap+a;
 				}
 				delta_qp=delta_qp+rho*a*((fabs(u)-u)/2)*y;
 			}
@@ -381,7 +537,6 @@ DEFINE_ON_DEMAND(VF_1_udf)
 					v=(C_V(c0,t0)+C_V(c1,t1))/2;
 					y=(C_YI(c0,t0,0)+C_YI(c1,t1,0))/2;
 					rho=(C_R(c0,t0)+C_R(c1,t1))/2;
-					Ap=Ap+a;
 				}
 				delta_qp=delta_qp+rho*a*((fabs(v)+v)/2)*y;
 			}
@@ -409,7 +564,6 @@ DEFINE_ON_DEMAND(VF_1_udf)
 					v=(C_V(c0,t0)+C_V(c1,t1))/2;
 					y=(C_YI(c0,t0,0)+C_YI(c1,t1,0))/2;
 					rho=(C_R(c0,t0)+C_R(c1,t1))/2;
-					Ap=Ap+a;
 				}
 				delta_qp=delta_qp+rho*a*((fabs(v)-v)/2)*y;
 			}
@@ -437,7 +591,6 @@ DEFINE_ON_DEMAND(VF_1_udf)
 					w=(C_W(c0,t0)+C_W(c1,t1))/2;
 					y=(C_YI(c0,t0,0)+C_YI(c1,t1,0))/2;
 					rho=(C_R(c0,t0)+C_R(c1,t1))/2;
-					Ap=Ap+a;
 				}
 				delta_qp=delta_qp+rho*a*((fabs(w)-w)/2)*y;
 			}
@@ -448,6 +601,7 @@ DEFINE_ON_DEMAND(VF_1_udf)
 	VF=1+(delta_qp/qp);
 	fprintf(fp_vf,"%g\n",VF);
 	fclose(fp_vf);
+	UDF_COUNTER_END(CNT_VF_1_UDF,udf_domain_faces(domain));
 }
 
 /*******************************TP term********************************/
@@ -456,12 +610,15 @@ DEFINE_ON_DEMAND(TP_1_udf)
 {
 	real TP;
 	FILE *fp_tp;
+	UDF_COUNTER_BEGIN;
 	fp_tp=fopen("TP.txt","a");
+	geo_ensure();
 	
 	TP=vol/(PFR*VF);
 	
 	fprintf(fp_tp,"%g\n",TP);
 	fclose(fp_tp);
+	UDF_COUNTER_END(CNT_TP_1_UDF,0);
 }
 
 /*******************************Q term********************************/
@@ -473,7 +630,7 @@ DEFINE_ON_DEMAND(Q_1_udf)
 	face_t f;
 	Thread *t0,*t1=NULL;
 	cell_t c0,c1=-1;
-	real delta_qp;
+	real delta_qp=0;
 	real x[ND_ND];
 	real NV_VEC(A);
 	real a;
@@ -481,6 +638,7 @@ DEFINE_ON_DEMAND(Q_1_udf)
 	real xxx,yyy,zzz;
 	real xx,yy,zz;
 	FILE *fp_q;
+	UDF_COUNTER_BEGIN;
 	fp_q=fopen("Q.txt","a");
 	domain=Get_Domain(1);
 	
@@ -611,6 +769,7 @@ DEFINE_ON_DEMAND(Q_1_udf)
 	Q=delta_qp;
 	fprintf(fp_q,"%g\n",Q);
 	fclose(fp_q);
+	UDF_COUNTER_END(CNT_Q_1_UDF,udf_domain_faces(domain));
 }
 
 /*****************************Tau_N term******************************/
@@ -618,12 +777,15 @@ DEFINE_ON_DEMAND(Q_1_udf)
 DEFINE_ON_DEMAND(Tau_N_1_udf)
 {
 	FILE *fp_tau_n;
+	UDF_COUNTER_BEGIN;
 	fp_tau_n=fopen("Tau_N.txt","a");
+	geo_ensure();
 	
 	Tau_N=vol/Q;
 
 	fprintf(fp_tau_n,"%g\n",Tau_N);
 	fclose(fp_tau_n);
+	UDF_COUNTER_END(CNT_TAU_N_1_UDF,0);
 }
 
 /*******************************ACH term********************************/
@@ -632,12 +794,14 @@ DEFINE_ON_DEMAND(ACH_1_udf)
 {
 	real ACH;
 	FILE *fp_ach;
+	UDF_COUNTER_BEGIN;
 	fp_ach=fopen("ACH.txt","a");
 	
 	ACH=3600/Tau_N;
 	
 	fprintf(fp_ach,"%g\n",ACH);
 	fclose(fp_ach);
+	UDF_COUNTER_END(CNT_ACH_1_UDF,0);
 }
 
 /*******************************Ea term********************************/
@@ -646,12 +810,14 @@ DEFINE_ON_DEMAND(Ea_1_udf)
 {
 	real Ea;
 	FILE *fp_ea;
+	UDF_COUNTER_BEGIN;
 	fp_ea=fopen("Ea.txt","a");
 	
 	Ea=Tau_N/Tau_R;
 	
 	fprintf(fp_ea,"%g\n",Ea);
 	fclose(fp_ea);
+	UDF_COUNTER_END(CNT_EA_1_UDF,0);
 }
 
 /*******************************NEV term*******************************/
@@ -659,12 +825,15 @@ DEFINE_ON_DEMAND(Ea_1_udf)
 DEFINE_ON_DEMAND(NEV_udf)
 {
 	FILE *fp_NEV;
+	UDF_COUNTER_BEGIN;
 	fp_NEV=fopen("NEV.txt","a");
+	geo_ensure();
 	
 	NEV=PFR/Ap;
 	
 	fprintf(fp_NEV,"%g\n",NEV);
 	fclose(fp_NEV);
+	UDF_COUNTER_END(CNT_NEV_UDF,0);
 }
 
 /***********************FAm*(in&out) & FAt* term************************/
@@ -681,14 +850,16 @@ DEFINE_ON_DEMAND(FA_roof_udf)
 	real x0[ND_ND],x1[ND_ND];
 	real NV_VEC(A);
 	real a;
-	real in,out,tur;
+	real in=0,out=0,tur=0;
 	real nut,nut0,nut1;
 	real u,v,w;
 	real y;
 	real xxx,yyy,zzz;
 	real xx,yy,zz;
 	FILE *fp_FA;
+	UDF_COUNTER_BEGIN;
 	fp_FA=fopen("FA_ROOF.txt","a");
+	geo_ensure();
 	domain=Get_Domain(1);
 	
 	thread_loop_f(t,domain)
@@ -713,7 +884,6 @@ DEFINE_ON_DEMAND(FA_roof_udf)
 				{
 					c1 = F_C1(f,t);
 					t1 = F_C1_THREAD(f,t);
-					a_roof=a_roof+a;
 					C_CENTROID(x0,c0,t0);
 					C_CENTROID(x1,c1,t1);
 					w=(C_W(c0,t0)+C_W(c1,t1))/2;
@@ -734,10 +904,48 @@ DEFINE_ON_DEMAND(FA_roof_udf)
 	FAt=-1*tur*RHO/M;
 	fprintf(fp_FA,"FAm_in_roof: %g\nFAm_out_roof: %g\nFAt: %g\na_roof: %g\n",FAm_in,FAm_out,FAt,a_roof);
 	fclose(fp_FA);
+	UDF_COUNTER_END(CNT_FA_ROOF_UDF,udf_domain_faces(domain));
 }
 
 /*****************************C_canopy term*****************************/
 
+static int hist_bucket(double y)
+{
+	//log bucket from the exponent and the top HIST_SUB mantissa bits, no log() per cell
+	union {double d; int64_t i;} b;
+
+	if(!(y>ldexp(1.,HIST_EMIN))) return 0;
+	if(y>=ldexp(1.,HIST_EMAX)) return HIST_N-1;
+	b.d=y;
+	return (int)((b.i>>(52-HIST_SUB))-((int64_t)(HIST_EMIN+1023)<<HIST_SUB))+1;
+}
+
+static double hist_edge(int k)
+{
+	//lower edge of bucket k (1..HIST_N-1)
+	int e=HIST_EMIN+((k-1)>>HIST_SUB),m=(k-1)&((1<<HIST_SUB)-1);
+	return ldexp(1.+(double)m/(1<<HIST_SUB),e);
+}
+
+static real hist_quantile(const real *h,real total,real p)
+{
+	//volume-weighted p-quantile, linear within the bucket
+	real cum=0,target=p*total;
+	int k;
+
+	for(k=0;k<HIST_N;k++)
+	{
+		if(h[k]>0 && cum+h[k]>=target)
+		{
+			if(k==0) return hist_edge(1);
+			if(k==HIST_N-1) return ldexp(1.,HIST_EMAX);
+			return hist_edge(k)+(hist_edge(k+1)-hist_edge(k))*(target-cum)/h[k];
+		}
+		cum=cum+h[k];
+	}
+	return 0;
+}
+
 DEFINE_ON_DEMAND(yCanopy_udf)
 
 {
@@ -746,16 +954,27 @@ DEFINE_ON_DEMAND(yCanopy_udf)
 	cell_t c;
 
 	real x[ND_ND];
-	real cpt;
+	real cpt=0;
 	real xxx,yyy,zzz;
 	real xx,yy,zz;
-	FILE *fp_C_canopy;
-	fp_C_canopy=fopen("C_canopy.txt","a");
+	real y,cv,v_doi=0;
+	real hist[HIST_N],exc[N_CTHR];	//mergeable: plain sums of volume
+	int j;
+	UDF_COUNTER_BEGIN;
+	geo_ensure();
 	domain=Get_Domain(1);
+	for(j=0;j<HIST_N;j++)
+	{
+		hist[j]=0;
+	}
+	for(j=0;j<N_CTHR;j++)
+	{
+		exc[j]=0;
+	}
 
 	thread_loop_c(t,domain)
 	{
-		begin_c_loop(c,t)
+		begin_c_loop_int(c,t)	//interior cells only, so no partition counts a halo cell twice
 		{
 			C_CENTROID(x,c,t);
 			xxx=ROUND(x[0]*100.0);
@@ -767,14 +986,53 @@ DEFINE_ON_DEMAND(yCanopy_udf)
        
 			if(xx>=XA && xx<=XB && yy>=YA && yy<=YB && zz>=ZA && zz<=ZB)
 			{
-				cpt=cpt+C_YI(c,t,0)*C_VOLUME(c,t);
+				y=C_YI(c,t,0);
+				cv=C_VOLUME(c,t);
+				cpt=cpt+y*cv;
+				v_doi=v_doi+cv;
+				hist[hist_bucket(y)]+=cv;
+				for(j=0;j<N_CTHR;j++)
+				{
+					exc[j]+=(y>c_thr[j])?cv:0;
+				}
 			}
 		}
-		end_c_loop(c,t)
+		end_c_loop_int(c,t)
+	}
+#if RP_NODE
+	{
+		real work[HIST_N];
+		PRF_GRSUM(hist,HIST_N,work);	//bucket sums of all partitions
+		PRF_GRSUM(exc,N_CTHR,work);
+		v_doi=PRF_GRSUM1(v_doi);
+		cpt=PRF_GRSUM1(cpt);
 	}
+#endif
 	C_canopy=cpt/vol; 
-	fprintf(fp_C_canopy,"C_canopy: %g\n",C_canopy);
-	fclose(fp_C_canopy);
+	C_p95=hist_quantile(hist,v_doi,0.95);
+	C_p99=hist_quantile(hist,v_doi,0.99);
+	for(j=0;j<N_CTHR;j++)
+	{
+		C_exceed[j]=(v_doi>0)?exc[j]/v_doi:0;
+	}
+#if !RP_HOST	//written once: by the serial process or by node 0
+#if RP_NODE
+	if(I_AM_NODE_ZERO_P)
+#endif
+	{
+		FILE *fp_C_canopy=fopen("C_canopy.txt","a");
+		if(fp_C_canopy!=NULL)
+		{
+			fprintf(fp_C_canopy,"C_canopy: %g\nC_p95: %g\nC_p99: %g\n",C_canopy,C_p95,C_p99);
+			for(j=0;j<N_CTHR;j++)
+			{
+				fprintf(fp_C_canopy,"C_exceed_%g: %g\n",c_thr[j],C_exceed[j]);
+			}
+			fclose(fp_C_canopy);
+		}
+	}
+#endif
+	UDF_COUNTER_END(CNT_YCANOPY_UDF,udf_domain_cells(domain));
 }
 
 /*******************************U_E term*******************************/
@@ -782,11 +1040,1096 @@ DEFINE_ON_DEMAND(yCanopy_udf)
 DEFINE_ON_DEMAND(U_E_udf)
 {
 	FILE *fp_U_E;
+	UDF_COUNTER_BEGIN;
 	fp_U_E=fopen("U_E.txt","a");
+	geo_ensure();
 	
 	U_E=((FAm_in+(-1*FAm_out)+FAt)*M)/(a_roof*C_canopy);
 	
 	fprintf(fp_U_E,"U_E: %g\n",U_E);
 	fclose(fp_U_E);
+	UDF_COUNTER_END(CNT_U_E_UDF,0);
+}
+
+
+/*****************Face geometry of DOI openings (FA_setup)****************/
+
+static int DOI_side(real x[ND_ND])
+{
+	//same rounding as FA_roof_udf; returns -1 if the face is not on an opening
+	real xx,yy,zz;
+	xx=ROUND(x[0]*100.0)/100.0;
+	yy=ROUND(x[1]*100.0)/100.0;
+	zz=ROUND(x[2]*100.0)/100.0;
+
+	if(xx==XA && yy>=YA && yy<=YB && zz>=ZA && zz<=ZB) return 0;
+	if(xx==XB && yy>=YA && yy<=YB && zz>=ZA && zz<=ZB) return 1;
+	if(xx>=XA && xx<=XB && yy==YA && zz>=ZA && zz<=ZB) return 2;
+	if(xx>=XA && xx<=XB && yy==YB && zz>=ZA && zz<=ZB) return 3;
+	if(xx>=XA && xx<=XB && yy>=YA && yy<=YB && zz==ZB) return 4;
+	return -1;
+}
+
+static void FA_free(void)
+{
+	free(fa_side); free(fa_c0); free(fa_c1); free(fa_t0); free(fa_t1);
+	free(fa_ax); free(fa_ay); free(fa_az); free(fa_w0); free(fa_g);
+	fa_side=NULL; fa_c0=NULL; fa_c1=NULL; fa_t0=NULL; fa_t1=NULL;
+	fa_ax=NULL; fa_ay=NULL; fa_az=NULL; fa_w0=NULL; fa_g=NULL;
+	fa_n=0;
+}
+
+DEFINE_ON_DEMAND(FA_setup_udf)
+{
+	//run once after the mesh is read; FA_udf runs it again when the mesh has changed.
+	//Every node keeps the principal opening faces it owns
+#if !RP_HOST
+	Domain *domain;
+	Thread *t;
+	face_t f;
+	Thread *t0,*t1;
+	cell_t c0,c1;
+	real x[ND_ND],x0[ND_ND],x1[ND_ND];
+	real NV_VEC(A);
+	real d[ND_ND];
+	real outward[5][3]={{-1,0,0},{1,0,0},{0,-1,0},{0,1,0},{0,0,1}};
+	real sgn,l0,l1,dd;
+	int n,s,k;
+#if RP_NODE
+	real work[5];
+#endif
+	UDF_COUNTER_BEGIN;
+	domain=Get_Domain(1);
+
+	FA_free();
+	for(s=0;s<5;s++)
+	{
+		a_side[s]=0;
+	}
+
+	n=0;
+	thread_loop_f(t,domain)
+	{
+		if(BOUNDARY_FACE_THREAD_P(t))
+		{
+			continue;	//openings are interior faces, as in FA_roof_udf
+		}
+		begin_f_loop(f,t)
+		{
+			if(!PRINCIPAL_FACE_P(f,t)) continue;	//partition boundary faces are counted by one node
+			F_CENTROID(x,f,t);
+			if(DOI_side(x)>=0)
+			{
+				n++;
+			}
+		}
+		end_f_loop(f,t)
+	}
+
+	fa_side=(int *)malloc(n*sizeof(int));
+	fa_c0=(cell_t *)malloc(n*sizeof(cell_t));
+	fa_c1=(cell_t *)malloc(n*sizeof(cell_t));
+	fa_t0=(Thread **)malloc(n*sizeof(Thread *));
+	fa_t1=(Thread **)malloc(n*sizeof(Thread *));
+	fa_ax=(real *)malloc(n*sizeof(real));
+	fa_ay=(real *)malloc(n*sizeof(real));
+	fa_az=(real *)malloc(n*sizeof(real));
+	fa_w0=(real *)malloc(n*sizeof(real));
+	fa_g=(real *)malloc(n*sizeof(real));
+
+	k=0;
+	thread_loop_f(t,domain)
+	{
+		if(BOUNDARY_FACE_THREAD_P(t))
+		{
+			continue;
+		}
+		begin_f_loop(f,t)
+		{
+			if(!PRINCIPAL_FACE_P(f,t)) continue;
+			F_CENTROID(x,f,t);
+			s=DOI_side(x);
+			if(s<0)
+			{
+				continue;
+			}
+			c0=F_C0(f,t);
+			t0=F_C0_THREAD(f,t);
+			c1=F_C1(f,t);
+			t1=F_C1_THREAD(f,t);
+			F_AREA(A,f,t);
+			C_CENTROID(x0,c0,t0);
+			C_CENTROID(x1,c1,t1);
+
+			sgn=(NV_DOT(A,outward[s])>=0)?1.:-1.;
+			d[0]=x1[0]-x0[0];
+			d[1]=x1[1]-x0[1];
+			d[2]=x1[2]-x0[2];
+			dd=NV_DOT(d,d);
+			l0=sqrt((x[0]-x0[0])*(x[0]-x0[0])+(x[1]-x0[1])*(x[1]-x0[1])+(x[2]-x0[2])*(x[2]-x0[2]));
+			l1=sqrt((x[0]-x1[0])*(x[0]-x1[0])+(x[1]-x1[1])*(x[1]-x1[1])+(x[2]-x1[2])*(x[2]-x1[2]));
+
+			fa_side[k]=s;
+			fa_c0[k]=c0;
+			fa_t0[k]=t0;
+			fa_c1[k]=c1;
+			fa_t1[k]=t1;
+			fa_ax[k]=sgn*A[0];
+			fa_ay[k]=sgn*A[1];
+			fa_az[k]=sgn*A[2];
+			fa_w0[k]=(l0+l1>0)?l1/(l0+l1):0.5;
+			fa_g[k]=(dd>0)?sgn*NV_DOT(A,d)/dd:0;
+			a_side[s]=a_side[s]+NV_MAG(A);
+			k++;
+		}
+		end_f_loop(f,t)
+	}
+	fa_n=k;
+	fa_stamp=udf_mesh_stamp(domain);
+#if RP_NODE
+	PRF_GRSUM(a_side,5,work);	//opening areas of all partitions
+	k=PRF_GISUM1(k);
+	if(I_AM_NODE_ZERO_P)
+#endif
+	Message("FA_setup_udf: %d opening faces (XA %g, XB %g, YA %g, YB %g, ZB %g m2)\n",k,a_side[0],a_side[1],a_side[2],a_side[3],a_side[4]);
+	UDF_COUNTER_END(CNT_FA_SETUP_UDF,udf_domain_faces(domain));
+#endif
+}
+
+/****************FAm* & FAt* term across all DOI openings*****************/
+
+DEFINE_ON_DEMAND(FA_udf)
+{
+	//streams over the arrays of FA_setup_udf; the ZB row matches FA_roof_udf.
+	//Sums of all nodes, FA.txt written by node 0
+#if !RP_HOST
+	real in[5]={0},out[5]={0},tur[5]={0};
+	real w0,w1,un,y,y0,y1,nut;
+	cell_t c0,c1;
+	Thread *t0,*t1;
+	const char *name[5]={"XA","XB","YA","YB","ZB"};
+	int k,s,changed;
+#if RP_NODE
+	real work[5];
+#endif
+	UDF_COUNTER_BEGIN;
+
+	if(fa_stamp==UDF_MESH_UNKNOWN)
+	{
+		//not fa_n==0: a partition may own no opening face
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("FA_udf: run FA_setup_udf first\n");
+		UDF_COUNTER_END(CNT_FA_UDF,fa_n);
+		return;
+	}
+	changed=(fa_stamp!=udf_mesh_stamp(Get_Domain(1)));
+#if RP_NODE
+	changed=PRF_GISUM1(changed);
+#endif
+	if(changed)
+	{
+		FA_setup_udf();	//mesh adapted since the arrays were built
+	}
+
+	for(k=0;k<fa_n;k++)
+	{
+		c0=fa_c0[k];
+		t0=fa_t0[k];
+		c1=fa_c1[k];
+		t1=fa_t1[k];
+		w0=fa_w0[k];
+		w1=1-w0;
+		s=fa_side[k];
+
+		un=(w0*C_U(c0,t0)+w1*C_U(c1,t1))*fa_ax[k]+(w0*C_V(c0,t0)+w1*C_V(c1,t1))*fa_ay[k]+(w0*C_W(c0,t0)+w1*C_W(c1,t1))*fa_az[k];
+		y0=C_YI(c0,t0,0);
+		y1=C_YI(c1,t1,0);
+		y=w0*y0+w1*y1;
+		nut=w0*C_MU_T(c0,t0)+w1*C_MU_T(c1,t1);
+
+		in[s]=in[s]+((fabs(un)-un)/2)*y;
+		out[s]=out[s]+((fabs(un)+un)/2)*y;
+		tur[s]=tur[s]-(nut/Sct)*(y1-y0)*fa_g[k];
+	}
+#if RP_NODE
+	PRF_GRSUM(in,5,work);
+	PRF_GRSUM(out,5,work);
+	PRF_GRSUM(tur,5,work);
+#endif
+
+	for(s=0;s<5;s++)
+	{
+		FA_in[s]=in[s]*RHO/M;	//Normalized by M
+		FA_out[s]=-1*out[s]*RHO/M;
+		FA_tur[s]=tur[s]*RHO/M;	//positive out of the DOI
+	}
+#if RP_NODE
+	if(I_AM_NODE_ZERO_P)
+#endif
+	{
+		FILE *fp_FA=fopen("FA.txt","a");
+		if(fp_FA!=NULL)
+		{
+			for(s=0;s<5;s++)
+			{
+				fprintf(fp_FA,"%s FAm_in: %g FAm_out: %g FAt: %g a: %g\n",name[s],FA_in[s],FA_out[s],FA_tur[s],a_side[s]);
+			}
+			fclose(fp_FA);
+		}
+	}
+	UDF_COUNTER_END(CNT_FA_UDF,fa_n);
+#endif
+}
+
+/************************Binary snapshot export***************************/
+
+typedef struct
+{
+	Thread *t;
+	int n;
+	int *idx;	//cell -> snapshot index, -1 if not exported
+} snap_thread;
+
+typedef struct
+{
+	snap_thread *st;	//fluid cell threads, grown as needed
+	int nt;
+	int *map;	//THREAD_ID -> index into st, -1 for other threads
+	int n_map;
+} snap_threads;
+
+static int snap_find(const snap_threads *s,Thread *t)
+{
+	int id=THREAD_ID(t);
+	return (id>=0 && id<s->n_map)?s->map[id]:-1;
+}
+
+static int snap_index(const snap_threads *s,Thread *t,cell_t c)
+{
+	int i=snap_find(s,t);
+	return (i<0)?-1:s->st[i].idx[c];
+}
+
+static void snap_free(snap_threads *s)
+{
+	int i;
+	for(i=0;i<s->nt;i++) free(s->st[i].idx);
+	free(s->st);
+	free(s->map);
+}
+
+static void snap_pad(FILE *fp)
+{
+	static const char zero[UMC_SNAP_ALIGN]={0};
+	long pos=ftell(fp);
+	fwrite(zero,1,UMC_ALIGN_UP(pos)-pos,fp);
+}
+
+static void write_snapshot(const char *name)
+{
+	//every compute node writes its own partition: interior cells first, then
+	//its exported exterior cells as ghosts, and only the principal faces, so
+	//that offline_ventilation_indices --merge can join the partition files
+#if !RP_HOST
+	Domain *domain;
+	Thread *t;
+	cell_t c,c0,c1;
+	face_t f;
+	real x[ND_ND];
+	real NV_VEC(A);
+	snap_threads s={NULL,0,NULL,0};
+	snap_thread *grow;
+	umc_snap_header h;
+	union {uint32_t i; char b[4];} endian={1};
+	double *buf;
+	int64_t *ibuf;
+	int cap=0,i,j,k,sp,n_species,ext;
+	int64_t nc=0,ng=0,nf=0,m,i0,i1;
+	char fname[256];
+	FILE *fp;
+	domain=Get_Domain(1);
+
+	if(!endian.b[0])
+	{
+		Message("export_snapshot: snapshots are little-endian only\n");
+		return;
+	}
+	if(compute_node_count>1) snprintf(fname,sizeof(fname),"%s.p%d",name,myid);
+	else snprintf(fname,sizeof(fname),"%s",name);
+
+	//1 mark exported cells: 1 inside the region, 2 halo
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		if(s.nt==cap)
+		{
+			cap=(cap>0)?2*cap:16;
+			grow=(snap_thread *)realloc(s.st,cap*sizeof(snap_thread));
+			if(grow==NULL)
+			{
+				Message("export_snapshot: out of memory, %s not written\n",fname);
+				snap_free(&s);
+				return;
+			}
+			s.st=grow;
+		}
+		if(THREAD_ID(t)>=s.n_map) s.n_map=THREAD_ID(t)+1;
+		s.st[s.nt].t=t;
+		s.st[s.nt].n=THREAD_N_ELEMENTS(t);
+		s.st[s.nt].idx=(int *)malloc((s.st[s.nt].n+1)*sizeof(int));
+		if(s.st[s.nt].idx==NULL)
+		{
+			Message("export_snapshot: out of memory, %s not written\n",fname);
+			snap_free(&s);
+			return;
+		}
+		begin_c_loop(c,t)
+		{
+			C_CENTROID(x,c,t);
+			s.st[s.nt].idx[c]=(!EXPORT_ROI || (x[0]>=EXPORT_XMIN && x[0]<=EXPORT_XMAX && x[1]>=EXPORT_YMIN && x[1]<=EXPORT_YMAX && x[2]>=EXPORT_ZMIN && x[2]<=EXPORT_ZMAX))?1:-1;
+		}
+		end_c_loop(c,t)
+		s.nt++;
+	}
+	s.map=(int *)malloc((s.n_map+1)*sizeof(int));
+	if(s.map==NULL)
+	{
+		Message("export_snapshot: out of memory, %s not written\n",fname);
+		snap_free(&s);
+		return;
+	}
+	for(i=0;i<s.n_map;i++) s.map[i]=-1;
+	for(i=0;i<s.nt;i++) s.map[THREAD_ID(s.st[i].t)]=i;
+	if(EXPORT_ROI)
+	{
+		thread_loop_f(t,domain)
+		{
+			if(BOUNDARY_FACE_THREAD_P(t)) continue;
+			begin_f_loop(f,t)
+			{
+				i=snap_find(&s,F_C0_THREAD(f,t));
+				j=snap_find(&s,F_C1_THREAD(f,t));
+				if(i<0 || j<0) continue;
+				c0=F_C0(f,t);
+				c1=F_C1(f,t);
+				if(s.st[i].idx[c0]==1 && s.st[j].idx[c1]<0) s.st[j].idx[c1]=2;
+				if(s.st[j].idx[c1]==1 && s.st[i].idx[c0]<0) s.st[i].idx[c0]=2;
+			}
+			end_f_loop(f,t)
+		}
+	}
+
+	//2 number the interior cells, then the exterior (ghost) cells, and count
+	//the principal faces between exported cells
+	for(ext=0;ext<2;ext++)
+	{
+		for(i=0;i<s.nt;i++)
+		{
+			j=THREAD_N_ELEMENTS_INT(s.st[i].t);
+			for(k=ext?j:0;k<(ext?s.st[i].n:j);k++)
+			{
+				s.st[i].idx[k]=(s.st[i].idx[k]>0)?(int)(nc++):-1;
+				ng+=(ext && s.st[i].idx[k]>=0);
+			}
+		}
+	}
+	thread_loop_f(t,domain)
+	{
+		begin_f_loop(f,t)
+		{
+			if(!PRINCIPAL_FACE_P(f,t)) continue;
+			if(snap_index(&s,F_C0_THREAD(f,t),F_C0(f,t))<0) continue;
+			if(!BOUNDARY_FACE_THREAD_P(t) && snap_index(&s,F_C1_THREAD(f,t),F_C1(f,t))<0) continue;
+			nf++;
+		}
+		end_f_loop(f,t)
+	}
+	n_species=(n_spe>0)?n_spe:0;
+
+	//3 header with the aligned array offsets
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,UMC_SNAP_MAGIC,8);
+	h.version=UMC_SNAP_VERSION;
+	h.header_size=sizeof(h);
+	h.n_cells=nc;
+	h.n_faces=nf;
+	h.n_species=n_species;
+	h.flags=(EXPORT_ROI?UMC_FLAG_ROI:0)|((compute_node_count>1)?UMC_FLAG_PART:0);
+	h.time=CURRENT_TIME;
+	if(EXPORT_ROI)
+	{
+		h.roi[0]=EXPORT_XMIN; h.roi[1]=EXPORT_XMAX;
+		h.roi[2]=EXPORT_YMIN; h.roi[3]=EXPORT_YMAX;
+		h.roi[4]=EXPORT_ZMIN; h.roi[5]=EXPORT_ZMAX;
+	}
+	h.n_ghost=ng;
+	h.part=myid;
+	h.n_parts=compute_node_count;
+	m=UMC_ALIGN_UP((int64_t)sizeof(h));
+	for(k=0;k<UMC_N_ARRAYS;k++)
+	{
+		h.offset[k]=m;
+		if(k<UMC_YI) m+=UMC_ALIGN_UP(nc*8);
+		else if(k==UMC_YI) m+=UMC_ALIGN_UP(nc*n_species*8);
+		else m+=UMC_ALIGN_UP(nf*8);
+	}
+
+	buf=(double *)malloc((nc>nf?nc:nf)*sizeof(double)+8);
+	fp=(buf!=NULL)?fopen(fname,"wb"):NULL;
+	if(fp==NULL)
+	{
+		Message("export_snapshot: cannot write %s\n",fname);
+		free(buf);
+		snap_free(&s);
+		return;
+	}
+	ibuf=(int64_t *)buf;
+	fwrite(&h,sizeof(h),1,fp);
+	snap_pad(fp);
+
+	//4 cell arrays, one gather per field
+	for(k=UMC_CX;k<=UMC_YI;k++)
+	{
+		for(sp=0;sp<((k==UMC_YI)?n_species:1);sp++)
+		{
+			for(i=0;i<s.nt;i++)
+			{
+				t=s.st[i].t;
+				begin_c_loop(c,t)
+				{
+					if(s.st[i].idx[c]<0) continue;
+					m=s.st[i].idx[c];
+					switch(k)
+					{
+						case UMC_CX: case UMC_CY: case UMC_CZ:
+							C_CENTROID(x,c,t);
+							buf[m]=x[k-UMC_CX];
+							break;
+						case UMC_VOL: buf[m]=C_VOLUME(c,t); break;
+						case UMC_U: buf[m]=C_U(c,t); break;
+						case UMC_V: buf[m]=C_V(c,t); break;
+						case UMC_W: buf[m]=C_W(c,t); break;
+						case UMC_K: buf[m]=NNULLP(THREAD_STORAGE(t,SV_K))?C_K(c,t):0; break;
+						case UMC_EPS: buf[m]=NNULLP(THREAD_STORAGE(t,SV_D))?C_D(c,t):0; break;
+						case UMC_MUT: buf[m]=C_MU_T(c,t); break;
+						case UMC_RHO: buf[m]=C_R(c,t); break;
+						default: buf[m]=C_YI(c,t,sp); break;
+					}
+				}
+				end_c_loop(c,t)
+			}
+			fwrite(buf,sizeof(double),nc,fp);
+		}
+		snap_pad(fp);
+	}
+
+	//5 face arrays
+	for(k=UMC_FC0;k<UMC_N_ARRAYS;k++)
+	{
+		m=0;
+		thread_loop_f(t,domain)
+		{
+			begin_f_loop(f,t)
+			{
+				if(!PRINCIPAL_FACE_P(f,t)) continue;
+				i0=snap_index(&s,F_C0_THREAD(f,t),F_C0(f,t));
+				if(i0<0) continue;
+				i1=-1;
+				if(!BOUNDARY_FACE_THREAD_P(t))
+				{
+					i1=snap_index(&s,F_C1_THREAD(f,t),F_C1(f,t));
+					if(i1<0) continue;
+				}
+				switch(k)
+				{
+					case UMC_FC0: ibuf[m]=i0; break;
+					case UMC_FC1: ibuf[m]=i1; break;
+					case UMC_FAX: case UMC_FAY: case UMC_FAZ:
+						F_AREA(A,f,t);
+						buf[m]=A[k-UMC_FAX];
+						break;
+					default:
+						F_CENTROID(x,f,t);
+						buf[m]=x[k-UMC_FX];
+						break;
+				}
+				m++;
+			}
+			end_f_loop(f,t)
+		}
+		fwrite(buf,8,nf,fp);
+		snap_pad(fp);
+	}
+	fclose(fp);
+	free(buf);
+	snap_free(&s);
+	Message("export_snapshot: %s (%ld cells, %ld ghosts, %ld faces)\n",fname,(long)(nc-ng),(long)ng,(long)nf);
+	if(compute_node_count>1 && I_AM_NODE_ZERO_P)
+	{
+		Message("export_snapshot: join %s.p0..p%d with offline_ventilation_indices --merge %s ...\n",name,compute_node_count-1,name);
+	}
+#endif
+}
+
+DEFINE_ON_DEMAND(export_snapshot_udf)
+{
+	UDF_COUNTER_BEGIN;
+	write_snapshot("snapshot.umc");
+	UDF_COUNTER_END(CNT_EXPORT_SNAPSHOT_UDF,udf_domain_cells(Get_Domain(1)));
+}
+
+DEFINE_EXECUTE_AT_END(export_snapshot_end)
+{
+	char fname[64];
+	int n=RP_Get_Boolean("rp-unsteady?")?N_TIME:N_ITER;
+
+	if(n%EXPORT_EVERY!=0) return;
+	sprintf(fname,"snapshot_%06d.umc",n);
+	write_snapshot(fname);
+}
+
+/***************************fast math switch******************************/
+
+DEFINE_ON_DEMAND(indices_fastmath_on)
+{
+	udf_fast_math=1;
+}
+
+DEFINE_ON_DEMAND(indices_fastmath_off)
+{
+	udf_fast_math=0;
+}
+
+DEFINE_ON_DEMAND(indices_fastmath_check)
+{
+	fastmath_sweep();
+}
+
+/**************************hot-path counters****************************/
+
+#ifdef UDF_COUNTERS
+DEFINE_ON_DEMAND(indices_counters_report)
+{
+	UDF_COUNTERS_REPORT("counters_indices.txt")
+}
+
+DEFINE_ON_DEMAND(indices_counters_reset)
+{
+	UDF_COUNTERS_RESET()
+}
+#endif
+
+/*********************Remapping weights to raster*************************/
+
+static int rs_n=0;              //number of voxels (rows)
+static int rs_ncol=0;           //number of mapped cells (columns)
+static int *rs_row=NULL;        //CSR row pointers, rs_n+1
+static int *rs_col=NULL;        //CSR column (mapped cell) indices
+static real *rs_w=NULL;         //CSR weights, normalized per voxel by the weights of all nodes
+static real *rs_cover=NULL;     //weight of the cells of all nodes in each voxel, 0: no data
+static Thread **rs_t=NULL;      //column -> cell
+static cell_t *rs_c=NULL;
+static real *rs_val=NULL;       //gathered field, one value per column
+static long long rs_stamp=UDF_MESH_UNKNOWN;	//mesh of the weights
+
+static void raster_range(real lo,real hi,real x0,real dx,int n,int *i0,int *i1)
+{
+	*i0=(int)floor((lo-x0)/dx);
+	*i1=(int)floor((hi-x0)/dx);
+	if(*i0<0) *i0=0;
+	if(*i1>n-1) *i1=n-1;
+}
+
+static real raster_overlap(real lo,real hi,real a,real b)
+{
+	real l=(hi<b?hi:b)-(lo>a?lo:a);
+	return (l>0)?l:0;
+}
+
+DEFINE_ON_DEMAND(raster_setup_udf)
+{
+	//cells are approximated by their node bounding box; the share of the box
+	//inside a voxel times C_VOLUME is the overlap weight
+#if !RP_HOST
+	Domain *domain;
+	Thread *t;
+	cell_t c;
+	Node *v;
+	real *box;
+	real bv,wv,ov;
+	int pass,n,k,j,d,i0,i1,j0,j1,k0,k1,ii,jj,kk,row;
+	int *fill;
+#if RP_NODE
+	real *work;
+#endif
+	domain=Get_Domain(1);
+
+	free(rs_row); free(rs_col); free(rs_w); free(rs_cover); free(rs_t); free(rs_c); free(rs_val);
+	rs_n=RASTER_NX*RASTER_NY*RASTER_NZ;
+	rs_row=(int *)calloc(rs_n+1,sizeof(int));
+
+	//1 node bounding box of every cell overlapping the raster
+	rs_ncol=0;
+	thread_loop_c(t,domain)
+	{
+		if(FLUID_THREAD_P(t)) rs_ncol+=THREAD_N_ELEMENTS_INT(t);
+	}
+	box=(real *)malloc(6*rs_ncol*sizeof(real));
+	rs_t=(Thread **)malloc(rs_ncol*sizeof(Thread *));
+	rs_c=(cell_t *)malloc(rs_ncol*sizeof(cell_t));
+	k=0;
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop_int(c,t)
+		{
+			real *b=&box[6*k];
+			b[0]=b[2]=b[4]=1e30;
+			b[1]=b[3]=b[5]=-1e30;
+			c_node_loop(c,t,n)
+			{
+				v=C_NODE(c,t,n);
+				for(d=0;d<3;d++)
+				{
+					if(NODE_COORD(v)[d]<b[2*d]) b[2*d]=NODE_COORD(v)[d];
+					if(NODE_COORD(v)[d]>b[2*d+1]) b[2*d+1]=NODE_COORD(v)[d];
+				}
+			}
+			if(b[1]<=RASTER_X0 || b[0]>=RASTER_X0+RASTER_NX*RASTER_DX) continue;
+			if(b[3]<=RASTER_Y0 || b[2]>=RASTER_Y0+RASTER_NY*RASTER_DX) continue;
+			if(b[5]<=RASTER_Z0 || b[4]>=RASTER_Z0+RASTER_NZ*RASTER_DZ) continue;
+			rs_t[k]=t;
+			rs_c[k]=c;
+			k++;
+		}
+		end_c_loop_int(c,t)
+	}
+	rs_ncol=k;
+
+	//2 count (pass 0) and fill (pass 1) the CSR matrix
+	fill=(int *)calloc(rs_n,sizeof(int));
+	for(pass=0;pass<2;pass++)
+	{
+		for(j=0;j<rs_ncol;j++)
+		{
+			real *b=&box[6*j];
+			bv=(b[1]-b[0])*(b[3]-b[2])*(b[5]-b[4]);
+			raster_range(b[0],b[1],RASTER_X0,RASTER_DX,RASTER_NX,&i0,&i1);
+			raster_range(b[2],b[3],RASTER_Y0,RASTER_DX,RASTER_NY,&j0,&j1);
+			raster_range(b[4],b[5],RASTER_Z0,RASTER_DZ,RASTER_NZ,&k0,&k1);
+			for(kk=k0;kk<=k1;kk++)
+			for(jj=j0;jj<=j1;jj++)
+			for(ii=i0;ii<=i1;ii++)
+			{
+				ov=raster_overlap(b[0],b[1],RASTER_X0+ii*RASTER_DX,RASTER_X0+(ii+1)*RASTER_DX)
+				  *raster_overlap(b[2],b[3],RASTER_Y0+jj*RASTER_DX,RASTER_Y0+(jj+1)*RASTER_DX)
+				  *raster_overlap(b[4],b[5],RASTER_Z0+kk*RASTER_DZ,RASTER_Z0+(kk+1)*RASTER_DZ);
+				if(ov<=0) continue;
+				row=(kk*RASTER_NY+jj)*RASTER_NX+ii;
+				if(pass==0)
+				{
+					rs_row[row+1]++;
+				}
+				else
+				{
+					rs_col[rs_row[row]+fill[row]]=j;
+					rs_w[rs_row[row]+fill[row]]=C_VOLUME(rs_c[j],rs_t[j])*ov/bv;
+					fill[row]++;
+				}
+			}
+		}
+		if(pass==0)
+		{
+			for(row=0;row<rs_n;row++)
+			{
+				rs_row[row+1]+=rs_row[row];
+			}
+			rs_col=(int *)malloc((rs_row[rs_n]>0?rs_row[rs_n]:1)*sizeof(int));
+			rs_w=(real *)malloc((rs_row[rs_n]>0?rs_row[rs_n]:1)*sizeof(real));
+		}
+	}
+
+	//3 normalize every row to a volume-weighted average over the cells of all nodes
+	rs_cover=(real *)calloc(rs_n,sizeof(real));
+	for(row=0;row<rs_n;row++)
+	{
+		for(k=rs_row[row];k<rs_row[row+1];k++) rs_cover[row]+=rs_w[k];
+	}
+#if RP_NODE
+	work=(real *)malloc(rs_n*sizeof(real));
+	PRF_GRSUM(rs_cover,rs_n,work);	//voxels straddling partitions
+	free(work);
+#endif
+	for(row=0;row<rs_n;row++)
+	{
+		wv=rs_cover[row];
+		for(k=rs_row[row];k<rs_row[row+1];k++) rs_w[k]/=wv;
+	}
+	rs_val=(real *)malloc((rs_ncol>0?rs_ncol:1)*sizeof(real));
+	free(box);
+	free(fill);
+	rs_stamp=udf_mesh_stamp(domain);
+	j=rs_ncol;
+	k=rs_row[rs_n];
+#if RP_NODE
+	j=PRF_GISUM1(j);
+	k=PRF_GISUM1(k);
+	if(I_AM_NODE_ZERO_P)
+#endif
+	Message("raster_setup_udf: %d voxels, %d cells, %d weights\n",rs_n,j,k);
+#endif
+}
+
+/*************Raster export of |U|, local age of air & C****************/
+
+static void raster_write(const char *field)
+{
+	//ESRI float grid (.flt + .hdr) per layer; rows run from north to south. Every node
+	//adds the weighted values of its cells, node 0 writes the sums of all nodes
+	char fname[128];
+	float *out;
+	real *acc;
+	int k,row,ii,jj,kk;
+	FILE *fp;
+#if RP_NODE
+	real *work;
+#endif
+
+	acc=(real *)calloc(rs_n,sizeof(real));
+	for(row=0;row<rs_n;row++)
+	{
+		for(k=rs_row[row];k<rs_row[row+1];k++)
+		{
+			acc[row]+=rs_w[k]*rs_val[rs_col[k]];
+		}
+	}
+#if RP_NODE
+	work=(real *)malloc(rs_n*sizeof(real));
+	PRF_GRSUM(acc,rs_n,work);
+	free(work);
+	if(!I_AM_NODE_ZERO_P)
+	{
+		free(acc);
+		return;
+	}
+#endif
+	out=(float *)malloc(RASTER_NX*sizeof(float));
+	for(kk=0;kk<RASTER_NZ;kk++)
+	{
+		sprintf(fname,"%s_z%d.hdr",field,kk);
+		fp=fopen(fname,"w");
+		if(fp==NULL) continue;
+		fprintf(fp,"ncols %d\nnrows %d\nxllcorner %.6f\nyllcorner %.6f\ncellsize %g\nNODATA_value -9999\nbyteorder LSBFIRST\n",
+			RASTER_NX,RASTER_NY,GEO_X0+RASTER_X0,GEO_Y0+RASTER_Y0,RASTER_DX);
+		fclose(fp);
+
+		sprintf(fname,"%s_z%d.flt",field,kk);
+		fp=fopen(fname,"wb");
+		if(fp==NULL) continue;
+		for(jj=RASTER_NY-1;jj>=0;jj--)
+		{
+			for(ii=0;ii<RASTER_NX;ii++)
+			{
+				row=(kk*RASTER_NY+jj)*RASTER_NX+ii;
+				out[ii]=(rs_cover[row]>0)?(float)acc[row]:-9999.f;
+			}
+			fwrite(out,sizeof(float),RASTER_NX,fp);
+		}
+		fclose(fp);
+	}
+	free(out);
+	free(acc);
+}
+
+DEFINE_ON_DEMAND(raster_export_udf)
+{
+#if !RP_HOST
+	Thread *t;
+	cell_t c;
+	int j,changed;
+
+	if(rs_row==NULL)
+	{
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("raster_export_udf: run raster_setup_udf first\n");
+		return;
+	}
+	changed=(rs_stamp!=udf_mesh_stamp(Get_Domain(1)));
+#if RP_NODE
+	changed=PRF_GISUM1(changed);
+#endif
+	if(changed)
+	{
+		raster_setup_udf();	//mesh adapted since the weights were built
+	}
+
+	for(j=0;j<rs_ncol;j++)
+	{
+		c=rs_c[j];
+		t=rs_t[j];
+		rs_val[j]=sqrt(C_U(c,t)*C_U(c,t)+C_V(c,t)*C_V(c,t)+C_W(c,t)*C_W(c,t));
+	}
+	raster_write("speed");
+
+	for(j=0;j<rs_ncol;j++)
+	{
+		rs_val[j]=C_YI(rs_c[j],rs_t[j],0)/M;	//local mean age, same scaling as LMAA_1_udf
+	}
+	raster_write("age");
+
+	for(j=0;j<rs_ncol;j++)
+	{
+		rs_val[j]=C_YI(rs_c[j],rs_t[j],0);
+	}
+	raster_write("concentration");
+#endif
+}
+
+/*******************Geometry reset & case/data read/write******************/
+
+DEFINE_ON_DEMAND(geo_reset_udf)
+{
+	//forces vol, Ap & a_roof to be recomputed on next use; a changed cell or face
+	//count (adaption, new case) is detected by geo_ensure without it
+	geo_valid=0;
+}
+
+DEFINE_RW_FILE(geo_write,fp)
+{
+	//hooked under Write Case (or Write Data), so that a restart needs no geometry sweep
+	fprintf(fp,"%d %.17g %.17g %.17g\n",geo_valid,(double)vol,(double)Ap,(double)a_roof);
+}
+
+DEFINE_RW_FILE(geo_read,fp)
+{
+	double v,ap,ar;
+	int valid;
+
+	if(fscanf(fp,"%d %lf %lf %lf",&valid,&v,&ap,&ar)==4 && valid)
+	{
+		vol=v;
+		Ap=ap;
+		a_roof=ar;
+		geo_valid=1;
+		geo_stamp=UDF_MESH_UNKNOWN;
+	}
+	else
+	{
+		geo_valid=0;
+	}
+}
+
+/****************Tracer-decay (puff) method of local age of air*************/
+
+static int decay_done=0;	//residual tracer below DECAY_STOP
+
+DEFINE_EXECUTE_AT_END(decay_accumulate)
+{
+	//up to t0 keeps the field to decay from, then adds C dt and (t-t0)C dt per cell
+	Domain *domain;
+	Thread *t;
+	cell_t c;
+	real x[ND_ND];
+	real time=CURRENT_TIME,dt=CURRENT_TIMESTEP;
+	real y,m=0,m0=0;
+	domain=Get_Domain(1);
+
+	if(!DECAY_MODE || !RP_Get_Boolean("rp-unsteady?") || N_UDM<UDM_DECAY+3)
+	{
+		return;
+	}
+	if(time<=DECAY_T0)
+	{
+		thread_loop_c(t,domain)
+		{
+			begin_c_loop(c,t)
+			{
+				C_UDMI(c,t,UDM_DECAY)=0;
+				C_UDMI(c,t,UDM_DECAY+1)=0;
+				C_UDMI(c,t,UDM_DECAY+2)=C_YI(c,t,0);
+			}
+			end_c_loop(c,t)
+		}
+		decay_done=0;
+		return;
+	}
+
+	if(decay_done)
+	{
+		return;
+	}
+	thread_loop_c(t,domain)
+	{
+		begin_c_loop_int(c,t)
+		{
+			y=C_YI(c,t,0);
+			C_UDMI(c,t,UDM_DECAY)=C_UDMI(c,t,UDM_DECAY)+y*dt;
+			C_UDMI(c,t,UDM_DECAY+1)=C_UDMI(c,t,UDM_DECAY+1)+(time-DECAY_T0)*y*dt;
+			C_CENTROID(x,c,t);
+			if(x[0]>=XA && x[0]<=XB && x[1]>=YA && x[1]<=YB && x[2]>=ZA && x[2]<=ZB)
+			{
+				m=m+y*C_VOLUME(c,t);
+				m0=m0+C_UDMI(c,t,UDM_DECAY+2)*C_VOLUME(c,t);
+			}
+		}
+		end_c_loop_int(c,t)
+	}
+#if RP_NODE
+	m=PRF_GRSUM1(m);	//all partitions stop together
+	m0=PRF_GRSUM1(m0);
+#endif
+	if(m0<=0 || m<DECAY_STOP*m0)
+	{
+		//residual tracer negligible: the moments are complete, no further sweeps
+#if RP_NODE
+		if(I_AM_NODE_ZERO_P)
+#endif
+		Message("decay_accumulate: residual tracer %g of that at t0, moments complete (run decay_result_udf)\n",(m0>0)?m/m0:0);
+		decay_done=1;
+	}
+}
+
+DEFINE_ON_DEMAND(decay_result_udf)
+{
+	//local age tau_p=int C dt/C(t0), averaged over the DOI, and mean age <tau>=int t<C> dt/int <C> dt
+	Domain *domain;
+	Thread *t;
+	cell_t c;
+	real x[ND_ND];
+	real age=0,v=0,m0=0,m1=0,mc0=0,mc=0;
+	domain=Get_Domain(1);
+
+	if(N_UDM<UDM_DECAY+3)
+	{
+		Message("decay_result_udf: %d user-defined memory locations needed\n",UDM_DECAY+3);
+		return;
+	}
+	thread_loop_c(t,domain)
+	{
+		begin_c_loop_int(c,t)	//interior cells only, so no partition counts a halo cell twice
+		{
+			C_CENTROID(x,c,t);
+			if(x[0]>=XA && x[0]<=XB && x[1]>=YA && x[1]<=YB && x[2]>=ZA && x[2]<=ZB)
+			{
+				if(C_UDMI(c,t,UDM_DECAY+2)>0)
+				{
+					age=age+C_UDMI(c,t,UDM_DECAY)/C_UDMI(c,t,UDM_DECAY+2)*C_VOLUME(c,t);
+					v=v+C_VOLUME(c,t);
+				}
+				m0=m0+C_UDMI(c,t,UDM_DECAY)*C_VOLUME(c,t);
+				m1=m1+C_UDMI(c,t,UDM_DECAY+1)*C_VOLUME(c,t);
+				mc0=mc0+C_UDMI(c,t,UDM_DECAY+2)*C_VOLUME(c,t);
+				mc=mc+C_YI(c,t,0)*C_VOLUME(c,t);
+			}
+		}
+		end_c_loop_int(c,t)
+	}
+#if RP_NODE
+	age=PRF_GRSUM1(age);
+	v=PRF_GRSUM1(v);
+	m0=PRF_GRSUM1(m0);
+	m1=PRF_GRSUM1(m1);
+	mc0=PRF_GRSUM1(mc0);
+	mc=PRF_GRSUM1(mc);
+#endif
+#if !RP_HOST	//written once: by the serial process or by node 0
+#if RP_NODE
+	if(I_AM_NODE_ZERO_P)
+#endif
+	{
+		FILE *fp_decay=fopen("DECAY.txt","a");
+		if(fp_decay!=NULL)
+		{
+			fprintf(fp_decay,"time: %g\nLMAA_decay: %g\nTau_mean_decay: %g\nresidual: %g\n",CURRENT_TIME,(v>0)?age/v:0,(m0>0)?m1/m0:0,(mc0>0)?mc/mc0:0);
+			fclose(fp_decay);
+		}
+	}
+#endif
+}
+
+/*****************Refinement marking around the target volume**************/
+
+static int adapt_region(real x[ND_ND])
+{
+	return x[0]>=XA-ADAPT_BUFFER && x[0]<=XB+ADAPT_BUFFER && x[1]>=YA-ADAPT_BUFFER && x[1]<=YB+ADAPT_BUFFER
+		&& x[2]>=ZA-ADAPT_BUFFER && x[2]<=ZB+ADAPT_BUFFER;
+}
+
+DEFINE_ADJUST(adapt_mark,domain)
+{
+	//indicators scaled by the cell size: |S|*h (shear layers, vortices) and |grad(Y)|*h (plume edges);
+	//the marks are turned into adaption registers by User Memory ADAPT in the solver
+	Thread *t;
+	cell_t c;
+	real x[ND_ND];
+	real h,eu,ey,eu_max=0,ey_max=0;
+	int n=RP_Get_Boolean("rp-unsteady?")?N_TIME:N_ITER;
+	int mark,n_refine=0,n_coarsen=0;
+
+	if(N_UDM<UDM_ADAPT+1 || n%ADAPT_EVERY!=0)
+	{
+		return;
+	}
+	thread_loop_c(t,domain)
+	{
+		int grad_y=NNULLP(THREAD_STORAGE(t,SV_Y_G));
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop_int(c,t)
+		{
+			C_CENTROID(x,c,t);
+			C_UDMI(c,t,UDM_ADAPT)=0;
+			if(adapt_region(x))
+			{
+				h=cbrt(C_VOLUME(c,t));
+				eu=C_STRAIN_RATE_MAG(c,t)*h;
+				ey=grad_y?NV_MAG(C_YI_G(c,t,0))*h:0;
+				if(eu>eu_max) eu_max=eu;
+				if(ey>ey_max) ey_max=ey;
+			}
+		}
+		end_c_loop_int(c,t)
+	}
+#if RP_NODE
+	eu_max=PRF_GRHIGH1(eu_max);	//the same thresholds on every partition
+	ey_max=PRF_GRHIGH1(ey_max);
+#endif
+	thread_loop_c(t,domain)
+	{
+		int grad_y=NNULLP(THREAD_STORAGE(t,SV_Y_G));
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop_int(c,t)
+		{
+			C_CENTROID(x,c,t);
+			if(!adapt_region(x)) continue;
+			h=cbrt(C_VOLUME(c,t));
+			eu=C_STRAIN_RATE_MAG(c,t)*h;
+			ey=grad_y?NV_MAG(C_YI_G(c,t,0))*h:0;
+			mark=0;
+			if(eu>ADAPT_REFINE*eu_max || ey>ADAPT_REFINE*ey_max)
+			{
+				mark=1;
+				n_refine++;
+			}
+			else if(eu<ADAPT_COARSEN*eu_max && ey<=ADAPT_COARSEN*ey_max)
+			{
+				mark=-1;
+				n_coarsen++;
+			}
+			C_UDMI(c,t,UDM_ADAPT)=mark;
+		}
+		end_c_loop_int(c,t)
+	}
+#if RP_NODE
+	n_refine=PRF_GISUM1(n_refine);
+	n_coarsen=PRF_GISUM1(n_coarsen);
+	if(I_AM_NODE_ZERO_P)
+#endif
+#if !RP_HOST
+	Message("adapt_mark: %d cells to refine, %d to coarsen\n",n_refine,n_coarsen);
+#endif
 }
 
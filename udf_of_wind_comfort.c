@@ -0,0 +1,138 @@
+/**************************************************************************
+                          wind comfort statistics
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+This UDF file folds the runs of several wind directions into wind comfort
+statistics without keeping the flow field of every direction. After each
+direction has converged (inlet direction set through udf/wind-dir, see
+udf_of_inlet.c), comfort_fold adds for every cell
+    P(U>U_thr) += f_d*exp(-(U_thr/(K*c_d))^k_d),   K=|U|/UREF_CFD
+where f_d, c_d and k_d are the frequency and Weibull parameters of the
+sector of the local wind rose (WIND_ROSE, lines of "dir(deg) f c k") and K
+is the amplification factor of the cell. The running sums are kept in
+cell user-defined memory UDM_WC..UDM_WC+N_THR (N_UDM >= UDM_WC+N_THR+1),
+which is saved with the data file.
+The UDF file includes the following terms:
+1  fold one wind direction into the exceedance probabilities (comfort_fold);
+2  reset of the accumulators (comfort_reset);
+**************************************************************************/
+
+#include "udf.h"
+
+#define WIND_ROSE "wind_rose.txt"
+#define WIND_DIR 0.           //wind direction (deg), used if udf/wind-dir is not defined
+#define UREF_CFD 4.8          //CFD wind speed at the reference height of the wind rose (m/s)
+#define N_THR 3               //number of speed thresholds
+#define N_SECTOR_MAX 72
+
+static const real thr[N_THR]={5.0,10.0,15.0};	//speed thresholds (m/s): comfort, strong wind, danger
+#define UDM_WC 0              //cell UDMs 0-3 of P(U>thr) per threshold; UDM_DECAY 4-6 & UDM_ADAPT 7 of the indices, UDM_DEP 8-10, UDM_CHEM 11-14
+#define UDM_F (UDM_WC+N_THR)  //UDM of the accumulated sector frequency
+
+static real wind_dir_deg(void)
+{
+	if(RP_Variable_Exists_P("udf/wind-dir"))
+	{
+		return RP_Get_Real("udf/wind-dir");
+	}
+	return WIND_DIR;
+}
+
+static int wind_rose_sector(real dir,real *f,real *c,real *k)
+{
+	//sector of the wind rose closest to dir; returns 0 if none is found
+	FILE *fp;
+	double d,ff,cc,kk;
+	real diff,best=360.;
+	int found=0;
+
+	fp=fopen(WIND_ROSE,"r");
+	if(fp==NULL)
+	{
+		return 0;
+	}
+	while(fscanf(fp,"%lf %lf %lf %lf",&d,&ff,&cc,&kk)==4)
+	{
+		diff=fabs(fmod(d-dir+540.,360.)-180.);
+		if(diff<best)
+		{
+			best=diff;
+			*f=ff;
+			*c=cc;
+			*k=kk;
+			found=1;
+		}
+	}
+	fclose(fp);
+	return found;
+}
+
+/***********************fold of one wind direction*************************/
+
+DEFINE_ON_DEMAND(comfort_fold)
+{
+	Domain *domain;
+	Thread *t;
+	cell_t c;
+	real dir,f,cw,kw;
+	real amp,p;
+	int j;
+	domain=Get_Domain(1);
+
+	if(N_UDM<UDM_F+1)
+	{
+		Message("comfort_fold: %d user-defined memory locations needed\n",UDM_F+1);
+		return;
+	}
+	dir=wind_dir_deg();
+	if(!wind_rose_sector(dir,&f,&cw,&kw))
+	{
+		Message("comfort_fold: no sector for %g deg in %s\n",dir,WIND_ROSE);
+		return;
+	}
+
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop(c,t)
+		{
+			amp=sqrt(C_U(c,t)*C_U(c,t)+C_V(c,t)*C_V(c,t)+C_W(c,t)*C_W(c,t))/UREF_CFD;
+			for(j=0;j<N_THR;j++)
+			{
+				p=(amp>0)?exp(-pow(thr[j]/(amp*cw),kw)):0;
+				C_UDMI(c,t,UDM_WC+j)=C_UDMI(c,t,UDM_WC+j)+f*p;
+			}
+			C_UDMI(c,t,UDM_F)=C_UDMI(c,t,UDM_F)+f;
+		}
+		end_c_loop(c,t)
+	}
+	Message("comfort_fold: direction %g deg folded (f=%g, c=%g, k=%g)\n",dir,f,cw,kw);
+}
+
+/**************************reset of accumulators***************************/
+
+DEFINE_ON_DEMAND(comfort_reset)
+{
+	Domain *domain;
+	Thread *t;
+	cell_t c;
+	int j;
+	domain=Get_Domain(1);
+
+	if(N_UDM<UDM_F+1)
+	{
+		return;
+	}
+	thread_loop_c(t,domain)
+	{
+		if(!FLUID_THREAD_P(t)) continue;
+		begin_c_loop(c,t)
+		{
+			for(j=0;j<=N_THR;j++)
+			{
+				C_UDMI(c,t,UDM_WC+j)=0;
+			}
+		}
+		end_c_loop(c,t)
+	}
+}
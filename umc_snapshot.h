@@ -0,0 +1,432 @@
+/**************************************************************************
+                          snapshot file layout
+@author:Jialei Shen
+@e-mail:shenjialei1992@163.com
+Binary layout of the cell/face snapshots exchanged between the UDFs and the
+offline tools. A snapshot is one little-endian file:
+1  a fixed umc_snap_header at offset 0;
+2  one contiguous array per field (structure of arrays), each starting at
+   header.offset[field], aligned to UMC_SNAP_ALIGN bytes, so that the file
+   can be mmap-ed and the arrays used in place.
+Cell arrays hold n_cells doubles (UMC_YI holds n_species*n_cells doubles,
+species by species; n_species is 0 without a species model, and readers
+that need Y check it). Face arrays hold n_faces values; UMC_FC0/UMC_FC1 are
+int64 indices into the cell arrays, UMC_FC1 is -1 on boundary faces and the
+area vector points from c0 to c1 (outward on boundary faces).
+A parallel export writes one file per compute node (flag UMC_FLAG_PART):
+the node's interior cells, then its n_ghost exterior cells, and only its
+principal faces. umc_snap_merge joins such partitions into one snapshot by
+matching every ghost cell with the owner cell at the same centroid.
+The offline tools define UMC_SNAPSHOT_READER before the include to get
+umc_snap_open/umc_snap_close, a validating mmap reader shared by all of
+them, and umc_snap_merge; the UDFs only use the layout.
+**************************************************************************/
+
+#ifndef UMC_SNAPSHOT_H
+#define UMC_SNAPSHOT_H
+
+#include <stdint.h>
+
+#define UMC_SNAP_MAGIC "UMCSNAP"   //7 chars + NUL
+#define UMC_SNAP_VERSION 2
+#define UMC_SNAP_ALIGN 64          //byte alignment of every array
+
+enum
+{
+	UMC_CX,UMC_CY,UMC_CZ,         //cell centroid (m)
+	UMC_VOL,                      //cell volume (m3)
+	UMC_U,UMC_V,UMC_W,            //velocity (m/s)
+	UMC_K,UMC_EPS,                //k (m2/s2) and e (m2/s3)
+	UMC_MUT,                      //turbulent viscosity (kg/m*s)
+	UMC_RHO,                      //density (kg/m3)
+	UMC_YI,                       //species mass fractions
+	UMC_FC0,UMC_FC1,              //face neighbours (int64)
+	UMC_FAX,UMC_FAY,UMC_FAZ,      //face area vector (m2)
+	UMC_FX,UMC_FY,UMC_FZ,         //face centroid (m)
+	UMC_N_ARRAYS
+};
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;          //sizeof(umc_snap_header) of the writer
+	uint64_t n_cells;
+	uint64_t n_faces;
+	uint32_t n_species;
+	uint32_t flags;                //UMC_FLAG_*
+	double time;                   //flow time (s), 0 for steady runs
+	double roi[6];                 //xmin,xmax,ymin,ymax,zmin,zmax of an ROI export
+	uint64_t offset[UMC_N_ARRAYS]; //byte offset of each array from the file start
+	uint64_t n_ghost;              //trailing cells owned by another partition (UMC_FLAG_PART only)
+	uint32_t part;                 //partition (compute node) of a parallel export
+	uint32_t n_parts;              //number of partitions of the export
+} umc_snap_header;
+
+#define UMC_FLAG_ROI 1             //only a region of interest (plus one halo layer) was written
+#define UMC_FLAG_PART 2            //one partition of a parallel export, to be merged
+
+#define UMC_ALIGN_UP(n) (((n)+UMC_SNAP_ALIGN-1)/UMC_SNAP_ALIGN*UMC_SNAP_ALIGN)
+
+#ifdef UMC_SNAPSHOT_READER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct
+{
+	const umc_snap_header *h;
+	const double *cx,*cy,*cz,*vol,*u,*v,*w,*k,*eps,*mut,*rho;
+	const double *yi;              //species 0; species i at yi+i*n_cells, NULL for n_species=0
+	const int64_t *fc0,*fc1;
+	const double *fax,*fay,*faz,*fx,*fy,*fz;
+	void *map;
+	size_t len;
+} umc_snapshot;
+
+static int umc_snap_fail(umc_snapshot *s,char *err,size_t n_err,const char *why)
+{
+	snprintf(err,n_err,"%s",why);
+	if(s->map!=NULL)
+	{
+		munmap(s->map,s->len);
+		s->map=NULL;
+	}
+	return -1;
+}
+
+static int umc_snap_map(const char *path,umc_snapshot *s,char *err,size_t n_err,int part)
+{
+	//maps a snapshot read-only and checks it completely before any array is used:
+	//header, every array inside the file and aligned, every face neighbour a valid cell;
+	//partitions of a parallel export only if part is set
+	int fd,i;
+	struct stat st;
+	const char *base;
+	const umc_snap_header *h;
+	uint64_t n,avail,f;
+
+	memset(s,0,sizeof(*s));
+	fd=open(path,O_RDONLY);
+	if(fd<0 || fstat(fd,&st)<0)
+	{
+		if(fd>=0) close(fd);
+		return umc_snap_fail(s,err,n_err,"cannot be opened");
+	}
+	if((size_t)st.st_size<sizeof(umc_snap_header))
+	{
+		close(fd);
+		return umc_snap_fail(s,err,n_err,"shorter than a snapshot header");
+	}
+	s->len=st.st_size;
+	s->map=mmap(NULL,s->len,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(s->map==MAP_FAILED)
+	{
+		s->map=NULL;
+		return umc_snap_fail(s,err,n_err,"cannot be mapped");
+	}
+	madvise(s->map,s->len,MADV_SEQUENTIAL);
+
+	base=(const char *)s->map;
+	h=(const umc_snap_header *)base;
+	if(memcmp(h->magic,UMC_SNAP_MAGIC,8)!=0)
+	{
+		return umc_snap_fail(s,err,n_err,"not a snapshot (bad magic)");
+	}
+	if(h->version!=UMC_SNAP_VERSION)
+	{
+		return umc_snap_fail(s,err,n_err,"unsupported snapshot version");
+	}
+	if(h->header_size<sizeof(umc_snap_header) || h->header_size>s->len)
+	{
+		return umc_snap_fail(s,err,n_err,"bad header size");
+	}
+	if(h->n_cells>s->len/sizeof(double) || h->n_faces>s->len/sizeof(double))
+	{
+		return umc_snap_fail(s,err,n_err,"cell or face count does not fit the file");
+	}
+	if(!part && (h->flags&UMC_FLAG_PART))
+	{
+		return umc_snap_fail(s,err,n_err,"one partition of a parallel export (join them with offline_ventilation_indices --merge)");
+	}
+	if(h->n_ghost>h->n_cells || (!(h->flags&UMC_FLAG_PART) && h->n_ghost>0) || h->n_parts<1 || h->part>=h->n_parts)
+	{
+		return umc_snap_fail(s,err,n_err,"bad partition header");
+	}
+	for(i=0;i<UMC_N_ARRAYS;i++)
+	{
+		if(h->offset[i]%UMC_SNAP_ALIGN!=0 || h->offset[i]<h->header_size || h->offset[i]>s->len)
+		{
+			return umc_snap_fail(s,err,n_err,"an array lies outside the file or is misaligned");
+		}
+		avail=(s->len-h->offset[i])/sizeof(double);	//int64 and double are both 8 bytes
+		n=(i<UMC_YI)?h->n_cells:h->n_faces;
+		if((i==UMC_YI)?(h->n_cells>0 && h->n_species>avail/h->n_cells):(n>avail))
+		{
+			return umc_snap_fail(s,err,n_err,"an array lies outside the file or is misaligned");
+		}
+	}
+
+	s->h=h;
+	s->cx=(const double *)(base+h->offset[UMC_CX]);
+	s->cy=(const double *)(base+h->offset[UMC_CY]);
+	s->cz=(const double *)(base+h->offset[UMC_CZ]);
+	s->vol=(const double *)(base+h->offset[UMC_VOL]);
+	s->u=(const double *)(base+h->offset[UMC_U]);
+	s->v=(const double *)(base+h->offset[UMC_V]);
+	s->w=(const double *)(base+h->offset[UMC_W]);
+	s->k=(const double *)(base+h->offset[UMC_K]);
+	s->eps=(const double *)(base+h->offset[UMC_EPS]);
+	s->mut=(const double *)(base+h->offset[UMC_MUT]);
+	s->rho=(const double *)(base+h->offset[UMC_RHO]);
+	s->yi=(h->n_species>0)?(const double *)(base+h->offset[UMC_YI]):NULL;
+	s->fc0=(const int64_t *)(base+h->offset[UMC_FC0]);
+	s->fc1=(const int64_t *)(base+h->offset[UMC_FC1]);
+	s->fax=(const double *)(base+h->offset[UMC_FAX]);
+	s->fay=(const double *)(base+h->offset[UMC_FAY]);
+	s->faz=(const double *)(base+h->offset[UMC_FAZ]);
+	s->fx=(const double *)(base+h->offset[UMC_FX]);
+	s->fy=(const double *)(base+h->offset[UMC_FY]);
+	s->fz=(const double *)(base+h->offset[UMC_FZ]);
+	for(f=0;f<h->n_faces;f++)
+	{
+		if(s->fc0[f]<0 || (uint64_t)s->fc0[f]>=h->n_cells || s->fc1[f]<-1 || (s->fc1[f]>=0 && (uint64_t)s->fc1[f]>=h->n_cells))
+		{
+			return umc_snap_fail(s,err,n_err,"a face neighbour is not a cell of the snapshot");
+		}
+	}
+	return 0;
+}
+
+static void umc_snap_close(umc_snapshot *s)
+{
+	if(s->map!=NULL)
+	{
+		munmap(s->map,s->len);
+		s->map=NULL;
+	}
+}
+
+static int umc_snap_open(const char *path,umc_snapshot *s,char *err,size_t n_err)
+{
+	return umc_snap_map(path,s,err,n_err,0);
+}
+
+typedef struct
+{
+	double x,y,z;
+	int64_t i;
+} umc_snap_owner;
+
+static int umc_snap_owner_cmp(const void *a,const void *b)
+{
+	const umc_snap_owner *p=(const umc_snap_owner *)a,*q=(const umc_snap_owner *)b;
+	if(p->x!=q->x) return (p->x<q->x)?-1:1;
+	if(p->y!=q->y) return (p->y<q->y)?-1:1;
+	if(p->z!=q->z) return (p->z<q->z)?-1:1;
+	return 0;
+}
+
+static void umc_snap_write_pad(FILE *fp)
+{
+	static const char zero[UMC_SNAP_ALIGN]={0};
+	long pos=ftell(fp);
+	fwrite(zero,1,UMC_ALIGN_UP(pos)-pos,fp);
+}
+
+static int umc_snap_merge(const char *out,char **paths,int n,char *err,size_t n_err)
+{
+	//joins the n partition files of one parallel export into the snapshot out:
+	//owned cells in partition order, ghost cells mapped to the owner cell with
+	//the nearest centroid within 1e-6 of the cell size, all principal faces
+	umc_snapshot *s;
+	umc_snap_header h;
+	umc_snap_owner *own=NULL;
+	int64_t **gmap,*base,n_cells=0,n_faces=0,c,f,lo,hi,best,m;
+	const umc_snapshot *p;
+	const char *a;
+	double tol,d,db,*buf=NULL;
+	int i,k,sp,ret=-1;
+	char why[160];
+	FILE *fp=NULL;
+
+	s=(umc_snapshot *)calloc(n,sizeof(umc_snapshot));
+	gmap=(int64_t **)calloc(n,sizeof(int64_t *));
+	base=(int64_t *)calloc(n+1,sizeof(int64_t));
+	if(s==NULL || gmap==NULL || base==NULL)
+	{
+		snprintf(err,n_err,"out of memory");
+		goto done;
+	}
+	for(i=0;i<n;i++)
+	{
+		if(umc_snap_map(paths[i],&s[i],why,sizeof(why),1)!=0)
+		{
+			snprintf(err,n_err,"%s: %s",paths[i],why);
+			goto done;
+		}
+	}
+	for(i=0;i<n;i++)
+	{
+		//partition i must sit at position part, all from one export
+		for(k=0;k<n && s[k].h->part!=(uint32_t)i;k++);
+		if(k==n || !(s[k].h->flags&UMC_FLAG_PART) || s[k].h->n_parts!=(uint32_t)n || s[k].h->n_species!=s[0].h->n_species || s[k].h->time!=s[0].h->time)
+		{
+			snprintf(err,n_err,"the files are not the %d partitions of one parallel export",n);
+			goto done;
+		}
+		if(k!=i)
+		{
+			umc_snapshot t=s[i];
+			s[i]=s[k];
+			s[k]=t;
+		}
+		base[i+1]=base[i]+(int64_t)(s[i].h->n_cells-s[i].h->n_ghost);
+		n_faces+=s[i].h->n_faces;
+	}
+	n_cells=base[n];
+
+	//1 owner cells sorted by centroid, every ghost looked up among them
+	own=(umc_snap_owner *)malloc((n_cells+1)*sizeof(umc_snap_owner));
+	if(own==NULL)
+	{
+		snprintf(err,n_err,"out of memory");
+		goto done;
+	}
+	for(i=0;i<n;i++)
+	{
+		p=&s[i];
+		for(c=0;c<base[i+1]-base[i];c++)
+		{
+			own[base[i]+c].x=p->cx[c];
+			own[base[i]+c].y=p->cy[c];
+			own[base[i]+c].z=p->cz[c];
+			own[base[i]+c].i=base[i]+c;
+		}
+	}
+	qsort(own,n_cells,sizeof(umc_snap_owner),umc_snap_owner_cmp);
+	for(i=0;i<n;i++)
+	{
+		p=&s[i];
+		gmap[i]=(int64_t *)malloc((p->h->n_cells+1)*sizeof(int64_t));
+		if(gmap[i]==NULL)
+		{
+			snprintf(err,n_err,"out of memory");
+			goto done;
+		}
+		for(c=0;c<(int64_t)p->h->n_cells;c++)
+		{
+			if(c<base[i+1]-base[i])
+			{
+				gmap[i][c]=base[i]+c;
+				continue;
+			}
+			tol=1e-6*cbrt(fabs(p->vol[c]));
+			lo=0;
+			hi=n_cells;
+			while(lo<hi)
+			{
+				m=(lo+hi)/2;
+				if(own[m].x<p->cx[c]-tol) lo=m+1;
+				else hi=m;
+			}
+			best=-1;
+			db=3*tol*tol;
+			for(;lo<n_cells && own[lo].x<=p->cx[c]+tol;lo++)
+			{
+				d=(own[lo].x-p->cx[c])*(own[lo].x-p->cx[c])+(own[lo].y-p->cy[c])*(own[lo].y-p->cy[c])+(own[lo].z-p->cz[c])*(own[lo].z-p->cz[c]);
+				if(d<=db)
+				{
+					db=d;
+					best=own[lo].i;
+				}
+			}
+			if(best<0 || (best>=base[i] && best<base[i+1]))
+			{
+				snprintf(err,n_err,"%s: ghost cell %lld has no owner in another partition",paths[i],(long long)c);
+				goto done;
+			}
+			gmap[i][c]=best;
+		}
+	}
+
+	//2 merged header and arrays
+	h=*s[0].h;
+	h.header_size=sizeof(h);
+	h.n_cells=n_cells;
+	h.n_faces=n_faces;
+	h.flags&=~UMC_FLAG_PART;
+	h.n_ghost=0;
+	h.part=0;
+	h.n_parts=1;
+	m=UMC_ALIGN_UP((int64_t)sizeof(h));
+	for(k=0;k<UMC_N_ARRAYS;k++)
+	{
+		h.offset[k]=m;
+		if(k<UMC_YI) m+=UMC_ALIGN_UP(n_cells*8);
+		else if(k==UMC_YI) m+=UMC_ALIGN_UP(n_cells*h.n_species*8);
+		else m+=UMC_ALIGN_UP(n_faces*8);
+	}
+	buf=(double *)malloc(((n_cells>n_faces)?n_cells:n_faces)*sizeof(double)+8);
+	fp=(buf!=NULL)?fopen(out,"wb"):NULL;
+	if(fp==NULL)
+	{
+		snprintf(err,n_err,"%s cannot be written",out);
+		goto done;
+	}
+	fwrite(&h,sizeof(h),1,fp);
+	umc_snap_write_pad(fp);
+	for(k=0;k<UMC_N_ARRAYS;k++)
+	{
+		for(sp=0;sp<((k==UMC_YI)?(int)h.n_species:1);sp++)
+		{
+			m=0;
+			for(i=0;i<n;i++)
+			{
+				p=&s[i];
+				a=(const char *)p->map+p->h->offset[k];
+				if(k<=UMC_YI)
+				{
+					memcpy(buf+m,a+sp*p->h->n_cells*8,(base[i+1]-base[i])*8);
+					m+=base[i+1]-base[i];
+				}
+				else
+				{
+					for(f=0;f<(int64_t)p->h->n_faces;f++)
+					{
+						if(k==UMC_FC0) ((int64_t *)buf)[m+f]=gmap[i][p->fc0[f]];
+						else if(k==UMC_FC1) ((int64_t *)buf)[m+f]=(p->fc1[f]<0)?-1:gmap[i][p->fc1[f]];
+						else buf[m+f]=((const double *)a)[f];
+					}
+					m+=p->h->n_faces;
+				}
+			}
+			fwrite(buf,8,m,fp);
+		}
+		umc_snap_write_pad(fp);
+	}
+	ret=ferror(fp)?-1:0;
+	if(ret!=0) snprintf(err,n_err,"%s cannot be written",out);
+
+done:
+	if(fp!=NULL) fclose(fp);
+	for(i=0;s!=NULL && i<n;i++) umc_snap_close(&s[i]);
+	for(i=0;gmap!=NULL && i<n;i++) free(gmap[i]);
+	free(s);
+	free(gmap);
+	free(base);
+	free(own);
+	free(buf);
+	return ret;
+}
+
+#endif
+
+#endif